@@ -0,0 +1,215 @@
+#include "allocations.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+namespace {
+
+struct Site {
+	std::atomic<const char*> name;
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> bytes;
+	std::atomic<int64_t> live;
+};
+
+// Sites are keyed by the zone name pointer. Slot 0 collects allocations outside
+// of any zone, and those of sites that no longer fit.
+const int SITES = 256;
+const char* const OTHER = "other";
+
+// Everything here is constant initialized, so allocations made while other
+// translation units are still being constructed are counted safely.
+Site sites[SITES];
+std::atomic<uint64_t> totalCount;
+std::atomic<uint64_t> totalBytes;
+std::atomic<int64_t> totalLive;
+thread_local const char* currentSite;
+thread_local Allocations::Counters threadCounters;
+
+}
+
+#ifdef T3DRIS_TRACK_ALLOCATIONS
+
+namespace {
+
+// Precedes every block so that delete knows its size and site.
+struct alignas(16) Header {
+	uint64_t size;
+	uint32_t site;
+};
+
+uint32_t siteIndex(const char* name) {
+	if (!name)
+		return 0;
+
+	const uintptr_t hash = (reinterpret_cast<uintptr_t>(name) >> 3) * 0x9E3779B97F4A7C15ull;
+	for (int probe = 0; probe < SITES - 1; probe++) {
+		const uint32_t index = 1 + (hash + probe) % (SITES - 1);
+		const char* key = sites[index].name.load(std::memory_order_acquire);
+		if (key == name)
+			return index;
+
+		if (!key) {
+			const char* expected = nullptr;
+			if (sites[index].name.compare_exchange_strong(expected, name, std::memory_order_acq_rel) || expected == name)
+				return index;
+		}
+	}
+
+	return 0;
+}
+
+void* allocate(std::size_t size) {
+	Header* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+	if (!header)
+		return nullptr;
+
+	header->size = size;
+	header->site = siteIndex(currentSite);
+
+	Site& site = sites[header->site];
+	site.count.fetch_add(1, std::memory_order_relaxed);
+	site.bytes.fetch_add(size, std::memory_order_relaxed);
+	site.live.fetch_add(int64_t(size), std::memory_order_relaxed);
+
+	totalCount.fetch_add(1, std::memory_order_relaxed);
+	totalBytes.fetch_add(size, std::memory_order_relaxed);
+	totalLive.fetch_add(int64_t(size), std::memory_order_relaxed);
+
+	threadCounters.count++;
+	threadCounters.bytes += size;
+	threadCounters.live += int64_t(size);
+	return header + 1;
+}
+
+void release(void* memory) {
+	if (!memory)
+		return;
+
+	Header* header = static_cast<Header*>(memory) - 1;
+	sites[header->site].live.fetch_sub(int64_t(header->size), std::memory_order_relaxed);
+	totalLive.fetch_sub(int64_t(header->size), std::memory_order_relaxed);
+	threadCounters.live -= int64_t(header->size);
+	std::free(header);
+}
+
+}
+
+void* operator new(std::size_t size) {
+	if (void* memory = allocate(size))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+	release(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	release(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	release(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+	release(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	release(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	release(memory);
+}
+
+#endif
+
+bool Allocations::isTracking() {
+#ifdef T3DRIS_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+Allocations::Counters Allocations::total() {
+	return { totalCount.load(std::memory_order_relaxed), totalBytes.load(std::memory_order_relaxed), totalLive.load(std::memory_order_relaxed) };
+}
+
+// Live bytes of a thread count what it allocated minus what it freed, whoever allocated that.
+Allocations::Counters Allocations::thread() {
+	return threadCounters;
+}
+
+// Returns the site to pass back to leaveSite().
+const char* Allocations::enterSite(const char* site) {
+	const char* previous = currentSite;
+	currentSite = site;
+	return previous;
+}
+
+void Allocations::leaveSite(const char* previous) {
+	currentSite = previous;
+}
+
+void Allocations::report(FILE* file) {
+	struct Line {
+		const char* name;
+		uint64_t count;
+		uint64_t bytes;
+		int64_t live;
+	};
+
+	Line lines[SITES];
+	int count = 0;
+	for (int i = 0; i < SITES; i++) {
+		const uint64_t allocations = sites[i].count.load(std::memory_order_relaxed);
+		if (allocations)
+			lines[count++] = { i ? sites[i].name.load(std::memory_order_acquire) : OTHER, allocations, sites[i].bytes.load(std::memory_order_relaxed),
+				sites[i].live.load(std::memory_order_relaxed) };
+	}
+
+	std::sort(lines, lines + count, [](const Line& a, const Line& b) { return a.live > b.live; });
+
+	fprintf(file, "%-24s %12s %14s %12s\n", "site", "allocations", "bytes", "live bytes");
+	for (int i = 0; i < count; i++)
+		fprintf(file, "%-24s %12llu %14llu %12lld\n", lines[i].name, (unsigned long long)lines[i].count, (unsigned long long)lines[i].bytes, (long long)lines[i].live);
+}
+
+AllocationGrowth::AllocationGrowth(unsigned window, FILE* file) : m_window(window), m_frames(0), m_live(-1), m_file(file) {
+}
+
+// The first window only sets the baseline, since startup grows the heap anyway.
+bool AllocationGrowth::frame() {
+	if (!Allocations::isTracking() || ++m_frames < m_window)
+		return false;
+
+	m_frames = 0;
+	const int64_t live = Allocations::total().live;
+	const int64_t previous = m_live;
+	m_live = live;
+	if (previous < 0 || live <= previous)
+		return false;
+
+	fprintf(m_file, "live heap grew by %lld bytes over %u frames\n", (long long)(live - previous), m_window);
+	Allocations::report(m_file);
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Heap allocation counters, filled in only by builds with
+// -DT3DRIS_TRACK_ALLOCATIONS, which replace the global operator new and delete.
+// Every allocation is charged to the calling thread and to its site: the
+// innermost profiler zone that thread is in, or "other" outside of any. Live
+// bytes are counted per site too, so growth across frames points at its zone.
+// Without the define every counter stays zero and isTracking() is false.
+class Allocations {
+
+public:
+	struct Counters {
+		uint64_t count;
+		uint64_t bytes;
+		int64_t live;
+	};
+
+	static bool isTracking();
+
+	static Counters total();
+	static Counters thread();
+
+	static const char* enterSite(const char* site);
+	static void leaveSite(const char* previous);
+
+	// Writes one line per site, largest live bytes first.
+	static void report(FILE* file);
+
+};
+
+// Reports through report() when live bytes grew over a window of frames.
+// Call frame() once per frame; it returns true when it reported.
+class AllocationGrowth {
+
+private:
+	const unsigned m_window;
+	unsigned m_frames;
+	int64_t m_live;
+	FILE* m_file;
+
+public:
+	AllocationGrowth(unsigned window, FILE* file);
+
+	bool frame();
+
+};
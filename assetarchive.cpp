@@ -0,0 +1,205 @@
+#include "assetarchive.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include "stb/stb_image.h"
+
+static const char MAGIC[4] = { 'T', '3', 'D', 'A' };
+static const size_t ALIGNMENT = 16;
+
+static void writeVarint(std::vector<unsigned char>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back((unsigned char)value);
+}
+
+static bool readVarint(const unsigned char* data, size_t size, size_t& offset, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && offset < size; shift += 7) {
+		const unsigned char byte = data[offset++];
+		value |= uint64_t(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& data) {
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	unsigned char buffer[4096];
+	for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+		data.insert(data.end(), buffer, buffer + read);
+	std::fclose(file);
+	return true;
+}
+
+AssetArchive::AssetArchive() {
+}
+
+void AssetArchive::close() {
+	m_file.close();
+	m_blobs.clear();
+	m_entries.clear();
+}
+
+bool AssetArchive::open(const char* path) {
+	close();
+	if (!m_file.open(path))
+		return false;
+
+	const unsigned char* const data = m_file.getData();
+	const size_t total = m_file.getSize();
+
+	// Everything the directory points at must lie inside the file.
+	size_t offset = sizeof(MAGIC);
+	uint64_t version, blobs, entries;
+	if (total < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 || !readVarint(data, total, offset, version) || version != VERSION ||
+		!readVarint(data, total, offset, blobs) || blobs > total) {
+		close();
+		return false;
+	}
+
+	for (uint64_t i = 0; i < blobs; i++) {
+		uint64_t kind, width, height, start, size;
+		if (!readVarint(data, total, offset, kind) || !readVarint(data, total, offset, width) || !readVarint(data, total, offset, height) ||
+			!readVarint(data, total, offset, start) || !readVarint(data, total, offset, size) || kind > 1 || start > total || size > total - start ||
+			(kind == 1 && (width > 65536 || height > 65536 || width * height * 4 != size))) {
+			close();
+			return false;
+		}
+
+		m_blobs.push_back({ data + start, size_t(size), int(width), int(height), kind == 1, int(i) });
+	}
+
+	if (!readVarint(data, total, offset, entries)) {
+		close();
+		return false;
+	}
+
+	for (uint64_t i = 0; i < entries; i++) {
+		uint64_t length, blob;
+		if (!readVarint(data, total, offset, length) || length > total - offset) {
+			close();
+			return false;
+		}
+
+		const std::string name(reinterpret_cast<const char*>(data + offset), size_t(length));
+		offset += size_t(length);
+		if (!readVarint(data, total, offset, blob) || blob >= m_blobs.size()) {
+			close();
+			return false;
+		}
+
+		m_entries[name] = int(blob);
+	}
+
+	return true;
+}
+
+bool AssetArchive::isOpen() const {
+	return m_file.isOpen();
+}
+
+const AssetArchive::Asset* AssetArchive::find(const std::string& name) const {
+	const auto entry = m_entries.find(name);
+	return entry == m_entries.end() ? nullptr : &m_blobs[entry->second];
+}
+
+bool AssetArchive::pack(const char* path, const std::vector<std::string>& files) {
+	struct Blob {
+		std::vector<unsigned char> data;
+		int width;
+		int height;
+		bool image;
+	};
+
+	std::vector<Blob> blobs;
+	std::map<std::vector<unsigned char>, int> contents;
+	std::vector<int> entries;
+
+	for (const std::string& name : files) {
+		Blob blob = { {}, 0, 0, false };
+		if (!readFile(name, blob.data))
+			return false;
+
+		// Identical files are recognized before decoding, so each image is decoded once.
+		const auto known = contents.find(blob.data);
+		if (known != contents.end()) {
+			entries.push_back(known->second);
+			continue;
+		}
+
+		const std::vector<unsigned char> encoded = blob.data;
+		const size_t extension = name.rfind('.');
+		if (extension != std::string::npos && name.compare(extension, std::string::npos, ".png") == 0) {
+			int channels = 0;
+			unsigned char* pixels = stbi_load_from_memory(encoded.data(), int(encoded.size()), &blob.width, &blob.height, &channels, 4);
+			if (!pixels)
+				return false;
+
+			blob.data.assign(pixels, pixels + size_t(blob.width) * blob.height * 4);
+			blob.image = true;
+			stbi_image_free(pixels);
+		}
+
+		contents[encoded] = int(blobs.size());
+		entries.push_back(int(blobs.size()));
+		blobs.push_back(std::move(blob));
+	}
+
+	// The directory size depends on the offsets it holds, so lay it out until it stops growing.
+	std::vector<unsigned char> directory;
+	std::vector<uint64_t> offsets(blobs.size());
+	for (size_t estimate = 0; ; estimate = directory.size()) {
+		uint64_t offset = (estimate + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		for (size_t i = 0; i < blobs.size(); i++) {
+			offsets[i] = offset;
+			offset = (offset + blobs[i].data.size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		}
+
+		directory.assign(MAGIC, MAGIC + sizeof(MAGIC));
+		writeVarint(directory, VERSION);
+		writeVarint(directory, blobs.size());
+		for (size_t i = 0; i < blobs.size(); i++) {
+			writeVarint(directory, blobs[i].image ? 1 : 0);
+			writeVarint(directory, blobs[i].width);
+			writeVarint(directory, blobs[i].height);
+			writeVarint(directory, offsets[i]);
+			writeVarint(directory, blobs[i].data.size());
+		}
+
+		writeVarint(directory, files.size());
+		for (size_t i = 0; i < files.size(); i++) {
+			writeVarint(directory, files[i].size());
+			directory.insert(directory.end(), files[i].begin(), files[i].end());
+			writeVarint(directory, entries[i]);
+		}
+
+		if (directory.size() <= estimate)
+			break;
+	}
+
+	std::FILE* file = std::fopen(path, "wb");
+	if (!file)
+		return false;
+
+	bool written = std::fwrite(directory.data(), 1, directory.size(), file) == directory.size();
+	uint64_t position = directory.size();
+	for (size_t i = 0; i < blobs.size() && written; i++) {
+		const std::vector<unsigned char> padding(size_t(offsets[i] - position), 0);
+		written = padding.empty() || std::fwrite(padding.data(), 1, padding.size(), file) == padding.size();
+		written = written && std::fwrite(blobs[i].data.data(), 1, blobs[i].data.size(), file) == blobs[i].data.size();
+		position = offsets[i] + blobs[i].data.size();
+	}
+
+	return std::fclose(file) == 0 && written;
+}
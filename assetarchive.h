@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "mappedfile.h"
+
+// A read-only pack of game files, memory mapped so opening it reads nothing
+// but the directory. Images are stored decoded to RGBA8 and every distinct
+// content is stored once, however many names point at it.
+// Layout: "T3DA", then varints VERSION, blob count and for every blob its
+// kind, width, height, offset and size, then the entry count and for every
+// entry its name length, name and blob. Blob data follows, 16-byte aligned,
+// at offsets counted from the start of the file.
+class AssetArchive {
+
+public:
+	static const uint32_t VERSION = 1;
+
+	struct Asset {
+		const unsigned char* data;
+		size_t size;
+		int width;
+		int height;
+		bool image;
+		int blob;
+	};
+
+private:
+	MappedFile m_file;
+	std::vector<Asset> m_blobs;
+	std::unordered_map<std::string, int> m_entries;
+
+	void close();
+
+public:
+	AssetArchive();
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	bool open(const char* path);
+	bool isOpen() const;
+
+	// Names are the paths the files were packed under, such as "resources/back.png".
+	const Asset* find(const std::string& name) const;
+
+	// Reads and packs files; .png files are decoded. Returns false if one could not be read.
+	static bool pack(const char* path, const std::vector<std::string>& files);
+
+};
@@ -0,0 +1,97 @@
+#include "assetloader.h"
+
+#include <cstdio>
+#include <algorithm>
+
+#include "stb/stb_image.h"
+
+#include "profiler.h"
+
+AssetLoader::AssetLoader(const AssetArchive& archive, unsigned threads) : m_archive(archive), m_pool(std::max(1u, threads)) {
+}
+
+// Queued loads are finished first: they write into jobs this loader owns.
+AssetLoader::~AssetLoader() {
+	m_pool.wait();
+}
+
+void AssetLoader::load(Job& job) {
+	PROFILE_SCOPE("AssetLoader::load");
+
+	if (job.asset) {
+		if (!job.asset->image) {
+			job.state.store(FAILED, std::memory_order_release);
+			return;
+		}
+
+		// Touch every page so the render thread does not fault them in during the upload.
+		volatile unsigned char sink = 0;
+		for (size_t i = 0; i < job.asset->size; i += 4096)
+			sink ^= job.asset->data[i];
+
+		job.image = { job.asset->data, job.asset->width, job.asset->height };
+		job.state.store(READY, std::memory_order_release);
+		return;
+	}
+
+	std::vector<unsigned char> encoded;
+	if (std::FILE* file = std::fopen(job.path.c_str(), "rb")) {
+		unsigned char buffer[4096];
+		for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+			encoded.insert(encoded.end(), buffer, buffer + read);
+		std::fclose(file);
+	}
+
+	int width = 0, height = 0, channels = 0;
+	unsigned char* pixels = encoded.empty() ? nullptr : stbi_load_from_memory(encoded.data(), int(encoded.size()), &width, &height, &channels, 4);
+	if (!pixels) {
+		job.state.store(FAILED, std::memory_order_release);
+		return;
+	}
+
+	job.decoded.assign(pixels, pixels + size_t(width) * height * 4);
+	stbi_image_free(pixels);
+	job.image = { job.decoded.data(), width, height };
+	job.state.store(READY, std::memory_order_release);
+}
+
+int AssetLoader::request(const std::string& path) {
+	const AssetArchive::Asset* asset = m_archive.find(path);
+	const std::string key = asset ? "#" + std::to_string(asset->blob) : path;
+
+	const auto known = m_keys.find(key);
+	if (known != m_keys.end())
+		return known->second;
+
+	const int handle = int(m_jobs.size());
+	m_jobs.emplace_back(new Job());
+	Job& job = *m_jobs.back();
+	job.path = path;
+	job.asset = asset;
+	job.state = LOADING;
+	job.image = { nullptr, 0, 0 };
+	m_keys[key] = handle;
+
+	m_pool.submit([&job](int) { load(job); });
+	return handle;
+}
+
+AssetLoader::State AssetLoader::getState(int handle) const {
+	return State(m_jobs[handle]->state.load(std::memory_order_acquire));
+}
+
+// Only valid once the image is READY.
+const AssetLoader::Image& AssetLoader::getImage(int handle) const {
+	return m_jobs[handle]->image;
+}
+
+// Drops decoded pixels after they were uploaded; images from the archive stay mapped.
+void AssetLoader::release(int handle) {
+	Job& job = *m_jobs[handle];
+	if (job.state.load(std::memory_order_acquire) != READY)
+		return;
+
+	std::vector<unsigned char>().swap(job.decoded);
+	if (!job.asset)
+		job.image.pixels = nullptr;
+}
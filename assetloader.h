@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "assetarchive.h"
+#include "threadpool.h"
+
+// Loads images on worker threads while the render thread keeps drawing.
+// request() returns a handle at once; the render thread checks getState() each
+// frame and uploads an image once it is READY, then may release() its pixels.
+// Images the archive holds come pre-decoded straight from its mapping, and the
+// worker only pages them in; others are read and decoded from their files. A
+// file or archive blob requested more than once is loaded once.
+class AssetLoader {
+
+public:
+	enum State {
+		LOADING,
+		READY,
+		FAILED
+	};
+
+	struct Image {
+		const unsigned char* pixels;
+		int width;
+		int height;
+	};
+
+private:
+	struct Job {
+		std::string path;
+		const AssetArchive::Asset* asset;
+		std::atomic<int> state;
+		std::vector<unsigned char> decoded;
+		Image image;
+	};
+
+	const AssetArchive& m_archive;
+	std::unordered_map<std::string, int> m_keys;
+	std::vector<std::unique_ptr<Job>> m_jobs;
+	ThreadPool m_pool;
+
+	static void load(Job& job);
+
+public:
+	AssetLoader(const AssetArchive& archive, unsigned threads);
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	int request(const std::string& path);
+	State getState(int handle) const;
+	const Image& getImage(int handle) const;
+	void release(int handle);
+
+};
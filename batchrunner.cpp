@@ -0,0 +1,102 @@
+#include "batchrunner.h"
+
+#include <memory>
+#include <chrono>
+
+#include "simulation.h"
+#include "random.h"
+#include "heuristic.h"
+#include "bot.h"
+
+static uint64_t mix(uint64_t value) {
+	value += 0x9E3779B97F4A7C15ull;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+BatchRunner::BatchRunner(int games, uint64_t seed, int size, int height, unsigned maxTicks, bool autoplay) : m_games(games), m_seed(seed), 
+	m_size(size), m_height(height), m_maxTicks(maxTicks), m_autoplay(autoplay) {
+}
+
+void BatchRunner::runShard(int first, int count, Result& result) const {
+	std::vector<std::unique_ptr<Simulation>> simulations(count);
+	std::vector<Random> inputs;
+	std::vector<unsigned> commands(count, 0);
+	std::vector<unsigned> lengths(count, 0);
+	std::vector<unsigned char> active(count, 1);
+
+	// The bot searches inline here; the shards themselves already occupy the pool.
+	ThreadPool inlinePool(0);
+	DefaultHeuristic heuristic;
+	std::vector<std::unique_ptr<Bot>> bots(m_autoplay ? count : 0);
+
+	inputs.reserve(count);
+	for (int lane = 0; lane < count; lane++) {
+		const uint64_t seed = mix(m_seed ^ mix(first + lane));
+		simulations[lane].reset(new Simulation(m_size, m_height, seed));
+		inputs.emplace_back(seed ^ 0x5DEECE66Dull);
+		if (m_autoplay)
+			bots[lane].reset(new Bot(inlinePool, heuristic, 0.0, SEARCH_LIMIT));
+	}
+
+	int running = count;
+	for (unsigned tick = 0; running > 0 && tick < m_maxTicks; tick++) {
+		if (!m_autoplay) {
+			for (int lane = 0; lane < count; lane++) {
+				const uint64_t roll = inputs[lane].nextInt();
+				commands[lane] = ((roll & 0x7) == 0) << ((roll >> 3) % 7);
+			}
+		}
+
+		for (int lane = 0; lane < count; lane++) {
+			if (!active[lane])
+				continue;
+
+			Simulation& simulation = *simulations[lane];
+			simulation.update(m_autoplay ? bots[lane]->update(simulation) : commands[lane]);
+			lengths[lane]++;
+
+			if (simulation.isGameOver()) {
+				result.scores[first + lane] = simulation.getHighScore();
+				result.pieces[first + lane] = simulation.getSpawnCount();
+				active[lane] = 0;
+				running--;
+				simulations[lane].reset();
+			}
+		}
+	}
+
+	for (int lane = 0; lane < count; lane++) {
+		if (active[lane]) {
+			result.scores[first + lane] = simulations[lane]->getGrid().getScore();
+			result.pieces[first + lane] = simulations[lane]->getSpawnCount();
+		}
+		result.lengths[first + lane] = lengths[lane];
+	}
+}
+
+BatchRunner::Result BatchRunner::run(ThreadPool& pool) const {
+	Result result;
+	result.scores.assign(m_games, 0);
+	result.lengths.assign(m_games, 0);
+	result.pieces.assign(m_games, 0);
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (int first = 0; first < m_games; first += LANES) {
+		const int count = std::min(LANES, m_games - first);
+		pool.submit([this, first, count, &result](int) {
+			runShard(first, count, result);
+		});
+	}
+
+	pool.wait();
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.ticks = 0;
+	for (unsigned length : result.lengths)
+		result.ticks += length;
+
+	return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "threadpool.h"
+
+// Plays many independent games, each seeded from the batch seed and its index,
+// with scripted random input or the bot. Games run in shards of LANES that
+// advance in lockstep; the per-game driver state of a shard is kept as parallel
+// arrays so the input for all lanes is produced in one loop. Shards are spread
+// over the pool, and the bot searches to a placement limit rather than a
+// deadline, so results do not depend on how they are scheduled.
+class BatchRunner {
+
+public:
+	static const int LANES = 64;
+	static const int SEARCH_LIMIT = 20000;
+
+	struct Result {
+		std::vector<int> scores;
+		std::vector<unsigned> lengths;
+		std::vector<unsigned> pieces;
+		unsigned long long ticks;
+		double seconds;
+	};
+
+private:
+	const int m_games;
+	const uint64_t m_seed;
+	const int m_size;
+	const int m_height;
+	const unsigned m_maxTicks;
+	const bool m_autoplay;
+
+	void runShard(int first, int count, Result& result) const;
+
+public:
+	BatchRunner(int games, uint64_t seed, int size, int height, unsigned maxTicks, bool autoplay);
+
+	Result run(ThreadPool& pool) const;
+
+};
@@ -0,0 +1,321 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#include "grid.h"
+#include "block.h"
+#include "mesher.h"
+#include "random.h"
+#include "simulation.h"
+#include "triplebuffer.h"
+#include "allocations.h"
+
+// Tracking builds charge allocations through Allocations; any other build of
+// the bench counts them here, so allocations per operation are always reported.
+#ifndef T3DRIS_TRACK_ALLOCATIONS
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+#endif
+
+static unsigned long long allocationCount() {
+#ifdef T3DRIS_TRACK_ALLOCATIONS
+	return Allocations::total().count;
+#else
+	return allocations.load(std::memory_order_relaxed);
+#endif
+}
+
+struct Arena {
+	int size;
+	int height;
+	double density;
+};
+
+static double minimumSeconds = 0.2;
+static const char* filter = "";
+static int allocatingCases = 0;
+
+// Runs batches of op until minimumSeconds passed and prints one CSV row.
+// op gets the index of the operation and may do its own setup. A case marked
+// allocationFree that still allocates once warmed up, in the batches of the
+// second half of its operations, fails the run.
+static void measure(const char* name, const Arena& arena, const std::function<void(unsigned)>& op, bool allocationFree = false) {
+	if (!std::strstr(name, filter))
+		return;
+
+	unsigned long long ops = 0;
+	unsigned long long allocated = 0;
+	std::vector<std::pair<unsigned long long, unsigned long long>> batches;
+	double seconds = 0;
+
+	for (unsigned long long batch = 1; seconds < minimumSeconds; ) {
+		const unsigned long long before = allocationCount();
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned long long i = 0; i < batch; i++)
+			op(unsigned(ops + i));
+
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const unsigned long long after = allocationCount();
+		allocated += after - before;
+		batches.push_back(std::make_pair(ops, after - before));
+		ops += batch;
+
+		// Grow the batch, but not past what should fill the remaining time.
+		const double remaining = (minimumSeconds - seconds) / (seconds / ops);
+		batch = std::max(1ull, std::min(batch * 2, (unsigned long long)remaining + 1));
+	}
+
+	std::printf("%s,%d,%d,%.2f,%llu,%.1f,%.3f\n", name, arena.size, arena.height, arena.density, ops, seconds * 1e9 / ops, double(allocated) / ops);
+	std::fflush(stdout);
+
+	unsigned long long warm = 0;
+	for (const auto& batch : batches)
+		if (batch.first >= ops / 2)
+			warm += batch.second;
+
+	if (allocationFree && warm) {
+		std::fprintf(stderr, "%s allocated %llu times in the second half of %llu operations\n", name, warm, ops);
+		allocatingCases++;
+	}
+}
+
+// The arena walls and floor as the game builds them, then random interior
+// cells up to three quarters of the height. No row is left full, so check()
+// leaves the board alone.
+static void fill(Grid& grid, const Arena& arena, Random& random) {
+	const Point& size = grid.getSize();
+	for (int x = 0; x < size.x; x++) {
+		for (int z = 0; z < size.z; z++) {
+			grid.set(x, 0, z, &Simulation::FLOOR_COLOR);
+			for (int y = 0; y < size.y - 1; y++)
+				if (x % (size.x - 1) == 0 || z == size.z - 1 || (z == 0 && y == 0))
+					grid.set(x, y, z, &Block::COLORS[random.nextInt() % 5]);
+		}
+	}
+
+	for (int y = 1; y < size.y * 3 / 4; y++)
+		for (int z = 1; z < size.z - 1; z++)
+			for (int x = 1; x < size.x - 1; x++)
+				if (random.next() < arena.density)
+					grid.set(x, y, z, &Block::COLORS[random.nextInt() % 5]);
+
+	for (int y = 1; y < size.y - 1; y++) {
+		for (int z = 1; z < size.z - 1; z++) {
+			for (int x = 1; x < size.x - 1; x++) {
+				if (grid.completesRow(x, y, z) && grid.isSolid(x, y, z)) {
+					grid.set(x, y, z, nullptr);
+					x = 0;
+				}
+			}
+		}
+	}
+}
+
+static std::vector<Point> interiorCells(const Grid& grid, Random& random, int count, bool top) {
+	const Point& size = grid.getSize();
+	std::vector<Point> cells;
+	for (int i = 0; i < count; i++) {
+		const int low = top ? size.y * 3 / 4 : 1;
+		cells.push_back({ 1 + int(random.nextInt() % (size.x - 2)), low + int(random.nextInt() % (size.y - 1 - low)), 1 + int(random.nextInt() % (size.z - 2)) });
+	}
+
+	return cells;
+}
+
+static void runArena(const Arena& arena) {
+	Random random(uint64_t(arena.size) * 1000003 + arena.height * 101 + int(arena.density * 100));
+	Grid grid({ arena.size, arena.height, arena.size });
+	fill(grid, arena, random);
+
+	const Point& size = grid.getSize();
+	const std::vector<Point> cells = interiorCells(grid, random, 4096, true);
+	const std::vector<Point> anywhere = interiorCells(grid, random, 4096, false);
+	const unsigned mask = 4095;
+
+	// Cells above the fill are set on even and cleared on odd operations, so the board ends as it started.
+	measure("grid.set", arena, [&](unsigned i) {
+		const Point& p = cells[(i >> 1) & mask];
+		grid.set(p.x, p.y, p.z, i & 1 ? nullptr : &Block::COLORS[i % 5]);
+	}, true);
+
+	measure("grid.check", arena, [&](unsigned i) {
+		const Point& p = anywhere[i & mask];
+		grid.check(p.x, p.y, p.z);
+	}, true);
+
+	measure("grid.isReady", arena, [&](unsigned /*i*/) {
+		if (!grid.isReady())
+			std::abort();
+	}, true);
+
+	{
+		Grid copy(grid);
+		measure("grid.removeRow", arena, [&](unsigned i) {
+			const int y = 1 + i % (size.y * 3 / 4 - 1);
+			const int z = 1 + i / 7 % (size.z - 2);
+			for (int x = 1; x < size.x - 1; x++)
+				copy.set(x, y, z, &Block::COLORS[i % 5]);
+
+			copy.check(size.x / 2, y, z);
+			copy.removeMarked();
+		});
+	}
+
+	{
+		Mesher mesher;
+		measure("mesher.full", arena, [&](unsigned /*i*/) {
+			mesher.clear();
+			mesher.update(grid);
+		});
+
+		measure("mesher.incremental", arena, [&](unsigned i) {
+			const Point& p = cells[(i >> 1) & mask];
+			grid.set(p.x, p.y, p.z, i & 1 ? nullptr : &Block::COLORS[i % 5]);
+			mesher.update(grid);
+		});
+	}
+
+	// Gravity never fires during these, so a piece stays where it was put.
+	const unsigned still = ~0u;
+
+	measure("block.construct", arena, [&](unsigned i) {
+		Block block(grid, still, i % pieces::TYPES);
+		if (block.getIndex() != i % pieces::TYPES)
+			std::abort();
+	}, true);
+
+	{
+		Block block(grid, still, 2);
+		block.draw();
+		measure("block.rotate", arena, [&](unsigned i) {
+			block.update(i & 1 ? COMMAND_ROTATE_Y : COMMAND_ROTATE_Z);
+		}, true);
+
+		measure("block.update", arena, [&](unsigned /*i*/) {
+			block.update(0);
+		}, true);
+
+		for (const Point& v : block.getBlocks())
+			grid.set(v.x, v.y, v.z, nullptr);
+	}
+
+	measure("block.hardDrop", arena, [&](unsigned i) {
+		Block block(grid, still, i % pieces::TYPES);
+		block.draw();
+		block.update(COMMAND_DROP);
+		for (const Point& v : block.getBlocks())
+			grid.set(v.x, v.y, v.z, nullptr);
+	}, true);
+
+	// A game played with scrambled input, restarted whenever it ends. The first
+	// game fills the chunk free list, so later ones run without the heap.
+	{
+		Simulation simulation(arena.size, arena.height, random.nextInt());
+		measure("simulation.update", arena, [&](unsigned i) {
+			const unsigned commands = (i * 2654435761u >> 13) & (COMMAND_RESTART - 1);
+			simulation.update(simulation.isGameOver() ? unsigned(COMMAND_RESTART) : commands);
+		}, true);
+
+		// Saving into a reused buffer stays off the heap; restoring builds a grid.
+		std::vector<unsigned char> state;
+		measure("simulation.save", arena, [&](unsigned /*i*/) {
+			simulation.save(state);
+		}, true);
+
+		Simulation copy(arena.size, arena.height, 1);
+		measure("simulation.restore", arena, [&](unsigned /*i*/) {
+			copy.restore(state.data(), state.size());
+		});
+	}
+
+	// A tick as SimulationThread runs it: the game is copied into the triple
+	// buffer slot the reader let go of, which hands its chunks back first. Not
+	// allocation-free: a tick that copies more chunks on write, or collapses more
+	// columns, than any tick before still allocates, a few times per 100k ticks.
+	{
+		Simulation live(arena.size, arena.height, random.nextInt());
+		TripleBuffer<Simulation> snapshots(live);
+		measure("simulation.publish", arena, [&](unsigned i) {
+			const unsigned commands = (i * 2654435761u >> 13) & (COMMAND_RESTART - 1);
+			live.update(live.isGameOver() ? unsigned(COMMAND_RESTART) : commands);
+
+			Simulation& snapshot = snapshots.back();
+			live.reclaim(snapshot);
+			snapshot = live;
+			snapshots.publish();
+			snapshots.update();
+		});
+	}
+}
+
+static std::vector<std::string> split(const char* text) {
+	std::vector<std::string> parts;
+	std::string part;
+	for (const char* c = text; ; c++) {
+		if (*c == ',' || !*c) {
+			if (!part.empty())
+				parts.push_back(part);
+			part.clear();
+			if (!*c)
+				break;
+		}
+		else {
+			part += *c;
+		}
+	}
+
+	return parts;
+}
+
+// Times the grid, mesher and piece hot paths over a set of arenas and fill
+// densities and prints CSV: case, size, height, density, ops, ns/op, allocations/op.
+// Allocations are only counted when built with -DT3DRIS_TRACK_ALLOCATIONS; such
+// a build exits with 2 when a case meant to be allocation-free allocated.
+// Usage: bench [filter] [arenas, e.g. 12x21,32x48] [densities, e.g. 0,0.3,0.6] [seconds per case]
+int main(int argc, char** argv) {
+	filter = argc > 1 && std::strcmp(argv[1], "all") != 0 ? argv[1] : "";
+	const std::vector<std::string> arenas = split(argc > 2 ? argv[2] : "12x21,32x48,64x96");
+	const std::vector<std::string> densities = split(argc > 3 ? argv[3] : "0,0.3,0.6");
+	if (argc > 4)
+		minimumSeconds = std::atof(argv[4]);
+
+	std::printf("case,size,height,density,ops,ns_per_op,allocs_per_op\n");
+
+	for (const std::string& size : arenas) {
+		Arena arena;
+		if (std::sscanf(size.c_str(), "%dx%d", &arena.size, &arena.height) != 2 || arena.size < 4 || arena.height < 6) {
+			std::fprintf(stderr, "bad arena %s\n", size.c_str());
+			return 1;
+		}
+
+		for (const std::string& density : densities) {
+			arena.density = std::atof(density.c_str());
+			runArena(arena);
+		}
+	}
+
+	return allocatingCases ? 2 : 0;
+}
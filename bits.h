@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bits {
+
+	inline int count(uint64_t word) {
+#ifdef _MSC_VER
+		return int(__popcnt64(word));
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+
+	inline int lowest(uint64_t word) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return int(index);
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+
+	inline bool test(const uint64_t* words, int bit) {
+		return (words[bit >> 6] >> (bit & 63)) & 1;
+	}
+
+	inline void set(uint64_t* words, int bit, bool value) {
+		if (value)
+			words[bit >> 6] |= uint64_t(1) << (bit & 63);
+		else
+			words[bit >> 6] &= ~(uint64_t(1) << (bit & 63));
+	}
+
+	inline bool covers(const uint64_t* words, const uint64_t* mask, int length) {
+		for (int i = 0; i < length; i++)
+			if ((words[i] & mask[i]) != mask[i])
+				return false;
+
+		return true;
+	}
+
+}
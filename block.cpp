@@ -1,224 +1,214 @@
-#include "block.h"
-
-engine::Vector4f Block::COLORS[5] = {
-	engine::Vector4f(1.0f, 0.0f, 0.0f, 1.0f),
-	engine::Vector4f(0.0f, 0.0f, 1.0f, 1.0f),
-	engine::Vector4f(0.5f, 0.0f, 0.5f, 1.0f),
-	engine::Vector4f(0.0f, 1.0f, 0.0f, 1.0f),
-	engine::Vector4f(1.0f, 1.0f, 0.0f, 1.0f)
-};
-
-Block::Block(Terrain& terrain, int speed, unsigned index) : terrain(terrain), m_updateTimer(speed), oValid(true), m_index(index) {
-	int x = terrain.getSize().x / 2 - 1;
-	int z = terrain.getSize().z / 2 - 1;
-
-	switch (index) {
-	case 0: { // Cube
-		m_middle = 0;
-
-		for (int i = 0; i < 2; i++)
-			for (int j = 0; j < 2; j++)
-				for (int k = 0; k < 2; k++)
-					m_blocks.push_back(engine::Vector3f(x + i, terrain.getSize().y - j - 2, z + k));
-		}
-		break;
-
-	case 1: { // I
-		m_middle = 2;
-
-		for (int i = 0; i < 4; i++)
-			m_blocks.push_back(engine::Vector3f(x + i, terrain.getSize().y - 2, z));
-		}
-		break;
-
-	case 2: { // L
-		m_middle = 0;
-
-		for (int i = 0; i < 3; i++)
-			m_blocks.push_back(engine::Vector3f(x + i, terrain.getSize().y - 2, z));
-
-		m_blocks.push_back(engine::Vector3f(x, terrain.getSize().y - 2, z + 1));
-		}
-		break;
-
-	case 3: { // S
-		m_middle = 2;
-
-		for (int i = 0; i < 2; i++) {
-			m_blocks.push_back(engine::Vector3f(x + i + 0, terrain.getSize().y - 2, z + 0));
-			m_blocks.push_back(engine::Vector3f(x + i + 1, terrain.getSize().y - 2, z + 1));
-		}
-		}
-		break;
-
-	default: { // T
-		m_middle = 1;
-
-		for (int i = 0; i < 3; i++)
-			m_blocks.push_back(engine::Vector3f(x + i, terrain.getSize().y - 2, z));
-
-		m_blocks.push_back(engine::Vector3f(x + 1, terrain.getSize().y - 2, z + 1));
-		}
-		break;
-	}
-
-	m_color = &COLORS[index < 4 ? index : 4];
-}
-
-void Block::draw() {
-	for (const engine::Vector3f& v : m_blocks)
-		terrain.set(v.x, v.y, v.z, m_color);
-}
-
-bool Block::update() {
-	bool valid = true;
-	for (const engine::Vector3f& v : m_blocks)
-		terrain.set(v.x, v.y, v.z, nullptr);
-
-	for (const engine::Vector3f& v : m_blocks)
-		if (terrain.getBlocks()[(v.z * terrain.getSize().y + (v.y - 1)) * terrain.getSize().x + v.x])
-			valid = false;
-
-	bool ready = m_updateTimer.ready();
-
-	if (ready && valid)
-		for (engine::Vector3f& v : m_blocks)
-			v.y -= 1;
-
-	if (valid && engine::Input::keyPressed(GLFW_KEY_SPACE)) {
-		bool valid = true;
-		m_updateTimer.reset();
-		while (valid) {
-			for (const engine::Vector3f& v : m_blocks)
-				if (terrain.getBlocks()[(v.z * terrain.getSize().y + (v.y - 1)) * terrain.getSize().x + v.x])
-					valid = false;
-
-			if (valid)
-				for (engine::Vector3f& v : m_blocks)
-					v.y -= 1;
-		}
-	}
-
-	oValid = valid;
-	valid = false;
-
-	if (m_index > 0 && engine::Input::keyPressed(GLFW_KEY_E)) {
-		engine::Vector3f middle = m_blocks[m_middle];
-		std::vector<engine::Vector3f> copy = m_blocks;
-		for (int i = 0; i < m_blocks.size(); i++) {
-			engine::Vector3f difference = middle - m_blocks[i];
-			float temp = difference.x;
-			difference.x = -difference.z;
-			difference.z = temp;
-			float y = m_blocks[i].y;
-			m_blocks[i] = middle + difference;
-			m_blocks[i].y = y;
-		}
-
-		for (engine::Vector3f& v : m_blocks) {
-			if ((v.z * terrain.getSize().y + v.y) * terrain.getSize().x + v.x < 0 || (v.z * terrain.getSize().y + v.y) * terrain.getSize().x + v.x > terrain.getBlocks().size() || 
-				terrain.getBlocks()[(v.z * terrain.getSize().y + v.y) * terrain.getSize().x + v.x]) {
-				m_blocks = copy;
-				break;
-			}
-		}
-	}
-
-	if (m_index > 0 && engine::Input::keyPressed(GLFW_KEY_Q)) {
-		engine::Vector3f middle = m_blocks[m_middle];
-		std::vector<engine::Vector3f> copy = m_blocks;
-		for (int i = 0; i < m_blocks.size(); i++) {
-			engine::Vector3f difference = middle - m_blocks[i];
-			float temp = difference.x;
-			difference.x = -difference.y;
-			difference.y = temp;
-			float z = m_blocks[i].z;
-			m_blocks[i] = middle + difference;
-			m_blocks[i].z = z;
-		}
-
-		for (engine::Vector3f& v : m_blocks) {
-			if ((v.z * terrain.getSize().y + v.y) * terrain.getSize().x + v.x < 0 || (v.z * terrain.getSize().y + v.y) * terrain.getSize().x + v.x > terrain.getBlocks().size() ||
-				terrain.getBlocks()[(v.z * terrain.getSize().y + v.y) * terrain.getSize().x + v.x]) {
-				m_blocks = copy;
-				break;
-			}
-		}
-	}
-
-	if (engine::Input::keyPressed(GLFW_KEY_D)) {
-		valid = true;
-		for (engine::Vector3f& v : m_blocks) {
-			if (v.x - 1 <= 0 || terrain.getBlocks()[(v.z * terrain.getSize().y + v.y) * terrain.getSize().x + (v.x - 1)]) {
-				valid = false;
-				break;
-			}
-		}
-		if (valid)
-			for (engine::Vector3f& v : m_blocks)
-				v.x -= 1;
-	}
-
-	if (engine::Input::keyPressed(GLFW_KEY_A)) {
-		valid = true;
-		for (engine::Vector3f& v : m_blocks) {
-			if (v.x + 1 >= terrain.getSize().x - 1 || terrain.getBlocks()[(v.z * terrain.getSize().y + v.y) * terrain.getSize().x + (v.x + 1)]) {
-				valid = false;
-				break;
-			}
-		}
-		if (valid)
-			for (engine::Vector3f& v : m_blocks)
-				v.x += 1;
-	}
-
-	if (engine::Input::keyPressed(GLFW_KEY_S)) {
-		valid = true;
-		for (engine::Vector3f& v : m_blocks) {
-			if (v.z - 1 <= 0 || terrain.getBlocks()[((v.z - 1) * terrain.getSize().y + v.y) * terrain.getSize().x + v.x]) {
-				valid = false;
-				break;
-			}
-		}
-		if (valid)
-			for (engine::Vector3f& v : m_blocks)
-				v.z -= 1;
-	}
-
-	if (engine::Input::keyPressed(GLFW_KEY_W)) {
-		valid = true;
-		for (engine::Vector3f& v : m_blocks) {
-			if (v.z + 1 >= terrain.getSize().z - 1 || terrain.getBlocks()[((v.z + 1) * terrain.getSize().y + v.y) * terrain.getSize().x + v.x]) {
-				valid = false;
-				break;
-			}
-		}
-		if (valid)
-			for (engine::Vector3f& v : m_blocks)
-				v.z += 1;
-	}
-
-	draw();
-
-	if (!oValid) {
-		for (const engine::Vector3f& v : m_blocks) {
-			if (v.y == terrain.getSize().y - 2)
-				gameOver = true;
-			if (terrain.check(v.x, v.y, v.z))
-				ready = true;
-		}
-	}
-
-	if (ready && !oValid)
-		return false;
-	else
-		return true;
-}
-
-std::vector<engine::Vector3f> Block::getBlocks() const {
-	return m_blocks;
-}
-
-unsigned Block::getIndex() const {
-	return m_index;
-}
+#include "block.h"
+
+const Color Block::COLORS[5] = {
+	{ 1.0f, 0.0f, 0.0f, 1.0f },
+	{ 0.0f, 0.0f, 1.0f, 1.0f },
+	{ 0.5f, 0.0f, 0.5f, 1.0f },
+	{ 0.0f, 1.0f, 0.0f, 1.0f },
+	{ 1.0f, 1.0f, 0.0f, 1.0f }
+};
+
+Block::Block(Grid& grid, unsigned speed, unsigned index) : grid(grid), m_updateTimer(speed, grid.getTime()), m_orientation(0), 
+	m_index(index < pieces::TYPES ? index : pieces::TYPES - 1), oValid(true), gameOver(false) {
+
+	const pieces::Offset& spawn = pieces::SPAWN[m_index];
+	m_position = { grid.getSize().x / 2 - 1 + spawn.x, grid.getSize().y - 2 + spawn.y, grid.getSize().z / 2 - 1 + spawn.z };
+	m_color = &COLORS[m_index];
+}
+
+Block::Block(Grid& grid, const Block& block) : grid(grid), m_position(block.m_position), m_color(block.m_color), m_updateTimer(block.m_updateTimer), 
+	m_orientation(block.m_orientation), m_index(block.m_index), oValid(block.oValid), gameOver(block.gameOver) {
+}
+
+// Copies the piece but stays on its own grid, so a simulation can hold its pieces by value.
+Block& Block::operator=(const Block& block) {
+	m_position = block.m_position;
+	m_color = block.m_color;
+	m_updateTimer = block.m_updateTimer;
+	m_orientation = block.m_orientation;
+	m_index = block.m_index;
+	oValid = block.oValid;
+	gameOver = block.gameOver;
+	return *this;
+}
+
+const pieces::Offset* Block::offsets(unsigned char orientation) const {
+	return pieces::TABLES.cells[m_index][orientation];
+}
+
+// The shipped arena probes with constant strides; any other size computes them.
+bool Block::fits(const Point& position, unsigned char orientation) const {
+	if (grid.getBoard().is(StandardBoard()))
+		return fits(StandardBoard(), position, orientation);
+
+	return fits(grid.getBoard(), position, orientation);
+}
+
+template <class B>
+bool Block::fits(const B& board, const Point& position, unsigned char orientation) const {
+	const pieces::Offset* cells = offsets(orientation);
+	for (int i = 0; i < pieces::CELL_COUNTS[m_index]; i++)
+		if (grid.isSolid(board, position.x + cells[i].x, position.y + cells[i].y, position.z + cells[i].z))
+			return false;
+
+	return true;
+}
+
+void Block::draw() {
+	for (const Point& v : getBlocks())
+		grid.set(v.x, v.y, v.z, m_color);
+}
+
+void Block::rotate(const unsigned char* table) {
+	if (fits(m_position, table[m_orientation]))
+		m_orientation = table[m_orientation];
+}
+
+bool Block::update(unsigned commands) {
+	for (const Point& v : getBlocks())
+		grid.set(v.x, v.y, v.z, nullptr);
+
+	const bool valid = fits({ m_position.x, m_position.y - 1, m_position.z }, m_orientation);
+
+	bool ready = m_updateTimer.ready(grid.getTime());
+
+	if (ready && valid)
+		m_position.y -= 1;
+
+	if (valid && (commands & COMMAND_DROP)) {
+		m_updateTimer.reset(grid.getTime());
+
+		int drop = grid.getSize().y;
+		for (const Point& v : getBlocks())
+			drop = std::min(drop, grid.dropDistance(v.x, v.y, v.z));
+
+		m_position.y -= drop;
+	}
+
+	oValid = valid;
+
+	if (m_index > 0 && (commands & COMMAND_ROTATE_Y))
+		rotate(pieces::TABLES.rotateY);
+
+	if (m_index > 0 && (commands & COMMAND_ROTATE_Z))
+		rotate(pieces::TABLES.rotateZ);
+
+	// The outer walls bound sideways moves: x and z stay inside 1 .. size - 2.
+	const Point& size = grid.getSize();
+	const pieces::Offset* offset = offsets(m_orientation);
+	const int count = pieces::CELL_COUNTS[m_index];
+	int minX = size.x, maxX = 0, minZ = size.z, maxZ = 0;
+	for (int i = 0; i < count; i++) {
+		minX = std::min(minX, m_position.x + offset[i].x);
+		maxX = std::max(maxX, m_position.x + offset[i].x);
+		minZ = std::min(minZ, m_position.z + offset[i].z);
+		maxZ = std::max(maxZ, m_position.z + offset[i].z);
+	}
+
+	if ((commands & COMMAND_LEFT) && minX - 1 > 0 && fits({ m_position.x - 1, m_position.y, m_position.z }, m_orientation)) {
+		m_position.x -= 1;
+		minX--;
+		maxX--;
+	}
+
+	if ((commands & COMMAND_RIGHT) && maxX + 1 < size.x - 1 && fits({ m_position.x + 1, m_position.y, m_position.z }, m_orientation))
+		m_position.x += 1;
+
+	if ((commands & COMMAND_BACK) && minZ - 1 > 0 && fits({ m_position.x, m_position.y, m_position.z - 1 }, m_orientation)) {
+		m_position.z -= 1;
+		minZ--;
+		maxZ--;
+	}
+
+	if ((commands & COMMAND_FORWARD) && maxZ + 1 < size.z - 1 && fits({ m_position.x, m_position.y, m_position.z + 1 }, m_orientation))
+		m_position.z += 1;
+
+	draw();
+
+	if (!oValid) {
+		for (const Point& v : getBlocks()) {
+			if (v.y == grid.getSize().y - 2)
+				gameOver = true;
+			if (grid.check(v.x, v.y, v.z))
+				ready = true;
+		}
+	}
+
+	if (ready && !oValid)
+		return false;
+	else
+		return true;
+}
+
+static bool isCoordinate(int64_t value) {
+	return value >= INT16_MIN && value <= INT16_MAX;
+}
+
+void Block::save(StateWriter& writer) const {
+	writer.write(m_index);
+	writer.write(m_orientation);
+	writer.writeSigned(m_position.x);
+	writer.writeSigned(m_position.y);
+	writer.writeSigned(m_position.z);
+	writer.write(m_updateTimer.getDelay());
+	writer.write(m_updateTimer.getLast());
+	writer.write(oValid | gameOver << 1);
+}
+
+// Every cell must lie on this block's grid, which is restored first.
+bool Block::restore(StateReader& reader) {
+	const uint64_t index = reader.read();
+	const uint64_t orientation = reader.read();
+	const int64_t x = reader.readSigned();
+	const int64_t y = reader.readSigned();
+	const int64_t z = reader.readSigned();
+	const uint64_t delay = reader.read();
+	const uint64_t last = reader.read();
+	const uint64_t flags = reader.read();
+	if (!reader.isValid() || index >= pieces::TYPES || orientation >= pieces::ORIENTATIONS || !isCoordinate(x) || !isCoordinate(y) || !isCoordinate(z) ||
+		delay > UINT32_MAX || last > UINT32_MAX || flags > 3) {
+		reader.fail();
+		return false;
+	}
+
+	const Point position = { int(x), int(y), int(z) };
+
+	const pieces::Offset* cells = pieces::TABLES.cells[index][orientation];
+	for (int i = 0; i < pieces::CELL_COUNTS[index]; i++) {
+		if (!grid.getBoard().contains(position.x + cells[i].x, position.y + cells[i].y, position.z + cells[i].z)) {
+			reader.fail();
+			return false;
+		}
+	}
+
+	m_index = unsigned(index);
+	m_orientation = (unsigned char)orientation;
+	m_position = position;
+	m_color = &COLORS[m_index];
+	m_updateTimer = StepTimer(unsigned(delay), unsigned(last));
+	oValid = flags & 1;
+	gameOver = (flags & 2) != 0;
+	return true;
+}
+
+BlockCells Block::getBlocks() const {
+	const pieces::Offset* offset = offsets(m_orientation);
+	BlockCells cells;
+	cells.count = pieces::CELL_COUNTS[m_index];
+	for (int i = 0; i < cells.count; i++)
+		cells.blocks[i] = { m_position.x + offset[i].x, m_position.y + offset[i].y, m_position.z + offset[i].z };
+
+	return cells;
+}
+
+const Point& Block::getPosition() const {
+	return m_position;
+}
+
+unsigned char Block::getOrientation() const {
+	return m_orientation;
+}
+
+unsigned Block::getIndex() const {
+	return m_index;
+}
@@ -1,37 +1,67 @@
-#pragma once
-
-#include <vector>
-#include <algorithm>
-
-#include "utilities/timer.h"
-#include "maths/random/random.h"
-#include "maths/maths.h"
-#include "window/input.h"
-
-#include "terrain.h"
-
-class Block {
-
-private:
-	std::vector<engine::Vector3f> m_blocks;
-	engine::Vector4f* m_color;
-	engine::Timer m_updateTimer;
-	int m_middle;
-	unsigned m_index;
-	Terrain& terrain;
-	bool oValid;
-
-public:
-	static engine::Vector4f COLORS[5];
-	bool gameOver;
-
-	Block(Terrain& terrain, int speed, unsigned index);
-
-	void draw();
-	bool update();
-
-	std::vector<engine::Vector3f> getBlocks() const;
-	unsigned getIndex() const;
-
-};
-
+#pragma once
+
+#include <algorithm>
+
+#include "steptimer.h"
+#include "grid.h"
+#include "pieces.h"
+#include "savestate.h"
+
+enum Command {
+	COMMAND_DROP = 1 << 0,
+	COMMAND_ROTATE_Y = 1 << 1,
+	COMMAND_ROTATE_Z = 1 << 2,
+	COMMAND_LEFT = 1 << 3,
+	COMMAND_RIGHT = 1 << 4,
+	COMMAND_BACK = 1 << 5,
+	COMMAND_FORWARD = 1 << 6,
+	COMMAND_RESTART = 1 << 7
+};
+
+struct BlockCells {
+	Point blocks[pieces::MAX_CELLS];
+	int count;
+
+	const Point* begin() const { return blocks; }
+	const Point* end() const { return blocks + count; }
+	const Point& operator[](int i) const { return blocks[i]; }
+};
+
+class Block {
+
+private:
+	Grid& grid;
+	Point m_position;
+	const Color* m_color;
+	StepTimer m_updateTimer;
+	unsigned char m_orientation;
+	unsigned m_index;
+	bool oValid;
+
+	const pieces::Offset* offsets(unsigned char orientation) const;
+	bool fits(const Point& position, unsigned char orientation) const;
+	template <class B>
+	bool fits(const B& board, const Point& position, unsigned char orientation) const;
+	void rotate(const unsigned char* table);
+
+public:
+	static const Color COLORS[5];
+	bool gameOver;
+
+	Block(Grid& grid, unsigned speed, unsigned index);
+	Block(Grid& grid, const Block& block);
+
+	Block& operator=(const Block& block);
+
+	void draw();
+	bool update(unsigned commands);
+
+	void save(StateWriter& writer) const;
+	bool restore(StateReader& reader);
+
+	BlockCells getBlocks() const;
+	const Point& getPosition() const;
+	unsigned char getOrientation() const;
+	unsigned getIndex() const;
+
+};
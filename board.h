@@ -0,0 +1,74 @@
+#pragma once
+
+struct Point {
+	int x, y, z;
+};
+
+// The dimensions of a grid and every index derived from them, in integers:
+// cells in CHUNK_SIZE cubes, columns (x, z), rows along X (y, z) and rows along
+// Z (y, x). Board<X, Y, Z> fixes the size at compile time, so strides and
+// bounds fold into constants and probes over a piece unroll; Board<> carries
+// the size at run time for custom arenas. Both have the same members, so code
+// templated on the board compiles for either.
+template <int X = 0, int Y = 0, int Z = 0>
+class Board {
+
+public:
+	static const int CHUNK_BITS = 4;
+	static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+
+private:
+	static constexpr int CHUNKS_X = (X + CHUNK_SIZE - 1) >> CHUNK_BITS;
+	static constexpr int CHUNKS_Z = (Z + CHUNK_SIZE - 1) >> CHUNK_BITS;
+
+public:
+	constexpr Board() {
+	}
+
+	constexpr Point getSize() const { return { X, Y, Z }; }
+
+	// One unsigned compare per axis, which also rejects negative coordinates.
+	constexpr bool contains(int x, int y, int z) const { return unsigned(x) < unsigned(X) && unsigned(y) < unsigned(Y) && unsigned(z) < unsigned(Z); }
+	constexpr int chunk(int x, int y, int z) const { return ((y >> CHUNK_BITS) * CHUNKS_Z + (z >> CHUNK_BITS)) * CHUNKS_X + (x >> CHUNK_BITS); }
+	constexpr int column(int x, int z) const { return z * X + x; }
+	constexpr int rowX(int y, int z) const { return y * Z + z; }
+	constexpr int rowZ(int y, int x) const { return y * X + x; }
+
+	static constexpr int local(int x, int y, int z) { return (((y & (CHUNK_SIZE - 1)) << CHUNK_BITS | (z & (CHUNK_SIZE - 1))) << CHUNK_BITS) | (x & (CHUNK_SIZE - 1)); }
+
+};
+
+template <>
+class Board<0, 0, 0> {
+
+public:
+	static const int CHUNK_BITS = Board<1, 1, 1>::CHUNK_BITS;
+	static const int CHUNK_SIZE = Board<1, 1, 1>::CHUNK_SIZE;
+
+private:
+	Point m_size;
+	Point m_chunkCount;
+
+public:
+	Board(Point size) : m_size(size),
+		m_chunkCount({ (size.x + CHUNK_SIZE - 1) >> CHUNK_BITS, (size.y + CHUNK_SIZE - 1) >> CHUNK_BITS, (size.z + CHUNK_SIZE - 1) >> CHUNK_BITS }) {
+	}
+
+	const Point& getSize() const { return m_size; }
+	const Point& getChunkCount() const { return m_chunkCount; }
+
+	template <int X, int Y, int Z>
+	bool is(const Board<X, Y, Z>&) const { return m_size.x == X && m_size.y == Y && m_size.z == Z; }
+
+	bool contains(int x, int y, int z) const { return unsigned(x) < unsigned(m_size.x) && unsigned(y) < unsigned(m_size.y) && unsigned(z) < unsigned(m_size.z); }
+	int chunk(int x, int y, int z) const { return ((y >> CHUNK_BITS) * m_chunkCount.z + (z >> CHUNK_BITS)) * m_chunkCount.x + (x >> CHUNK_BITS); }
+	int column(int x, int z) const { return z * m_size.x + x; }
+	int rowX(int y, int z) const { return y * m_size.z + z; }
+	int rowZ(int y, int x) const { return y * m_size.x + x; }
+
+	static constexpr int local(int x, int y, int z) { return Board<1, 1, 1>::local(x, y, z); }
+
+};
+
+// The arena the game ships with. Grids of this size take the specialized paths.
+typedef Board<12, 21, 12> StandardBoard;
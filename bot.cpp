@@ -0,0 +1,283 @@
+#include "bot.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "profiler.h"
+
+static const float LOST = -std::numeric_limits<float>::max();
+
+Bot::Bot(ThreadPool& pool, const Heuristic& heuristic, double budget, int limit) : m_pool(pool), m_heuristic(heuristic), 
+	m_budget(static_cast<long long>(budget * 1000)), m_limit(limit), m_hasTarget(false), m_spawnCount(0), m_lastPosition({ -1, -1, -1 }), m_lastOrientation(0), m_stall(0), m_evaluated(0), m_remaining(0) {
+
+	// Orientations giving the same cells around the pivot are the same placement.
+	for (unsigned type = 0; type < pieces::TYPES; type++) {
+		std::vector<std::vector<int>> seen;
+		for (unsigned char o = 0; o < (type > 0 ? pieces::ORIENTATIONS : 1); o++) {
+			std::vector<int> cells;
+			for (int c = 0; c < pieces::CELL_COUNTS[type]; c++) {
+				const pieces::Offset& offset = pieces::TABLES.cells[type][o][c];
+				cells.push_back((offset.x * 16 + offset.y) * 16 + offset.z);
+			}
+			std::sort(cells.begin(), cells.end());
+
+			if (std::find(seen.begin(), seen.end(), cells) == seen.end()) {
+				seen.push_back(cells);
+				m_orientations[type].push_back(o);
+			}
+		}
+	}
+
+	// First rotation command on a shortest path between any two orientations.
+	for (int start = 0; start < pieces::ORIENTATIONS; start++) {
+		int queue[pieces::ORIENTATIONS];
+		bool visited[pieces::ORIENTATIONS] = {};
+		int head = 0, tail = 0;
+
+		queue[tail++] = start;
+		visited[start] = true;
+		m_rotationSteps[start][start] = 0;
+
+		while (head < tail) {
+			const int current = queue[head++];
+			const int turns[2] = { pieces::TABLES.rotateY[current], pieces::TABLES.rotateZ[current] };
+			for (int t = 0; t < 2; t++) {
+				if (visited[turns[t]])
+					continue;
+
+				visited[turns[t]] = true;
+				m_rotationSteps[start][turns[t]] = current == start ? unsigned(t == 0 ? COMMAND_ROTATE_Y : COMMAND_ROTATE_Z) : m_rotationSteps[start][current];
+				queue[tail++] = turns[t];
+			}
+		}
+	}
+}
+
+void Bot::enumerate(const Grid& grid, unsigned type, std::vector<Placement>& placements) const {
+	if (grid.getBoard().is(StandardBoard()))
+		enumerate(StandardBoard(), grid, type, placements);
+	else
+		enumerate(grid.getBoard(), grid, type, placements);
+}
+
+template <class B>
+void Bot::enumerate(const B& board, const Grid& grid, unsigned type, std::vector<Placement>& placements) const {
+	const Point size = board.getSize();
+	const int y = size.y - 2 + pieces::SPAWN[type].y;
+
+	placements.clear();
+
+	for (unsigned char o : m_orientations[type]) {
+		const pieces::Offset* offsets = pieces::TABLES.cells[type][o];
+		int minX = 0, maxX = 0, minZ = 0, maxZ = 0;
+		for (int c = 0; c < pieces::CELL_COUNTS[type]; c++) {
+			minX = std::min(minX, int(offsets[c].x));
+			maxX = std::max(maxX, int(offsets[c].x));
+			minZ = std::min(minZ, int(offsets[c].z));
+			maxZ = std::max(maxZ, int(offsets[c].z));
+		}
+
+		for (int z = 1 - minZ; z + maxZ < size.z - 1; z++) {
+			for (int x = 1 - minX; x + maxX < size.x - 1; x++) {
+				bool fits = true;
+				for (int c = 0; fits && c < pieces::CELL_COUNTS[type]; c++)
+					fits = !grid.isSolid(board, x + offsets[c].x, y + offsets[c].y, z + offsets[c].z);
+
+				if (fits)
+					placements.push_back({ o, x, z });
+			}
+		}
+	}
+}
+
+int Bot::land(const Grid& grid, unsigned type, const Placement& placement, Point* cells) const {
+	const pieces::Offset* offsets = pieces::TABLES.cells[type][placement.orientation];
+	const int y = grid.getSize().y - 2 + pieces::SPAWN[type].y;
+	const int count = pieces::CELL_COUNTS[type];
+
+	int drop = grid.getSize().y;
+	for (int c = 0; c < count; c++) {
+		cells[c] = { placement.x + offsets[c].x, y + offsets[c].y, placement.z + offsets[c].z };
+		drop = std::min(drop, grid.dropDistance(cells[c].x, cells[c].y, cells[c].z));
+	}
+
+	for (int c = 0; c < count; c++)
+		cells[c].y -= drop;
+
+	return count;
+}
+
+float Bot::evaluate(Grid& scratch, unsigned type, const Placement& placement) const {
+	Point cells[pieces::MAX_CELLS];
+	const int count = land(scratch, type, placement, cells);
+
+	bool lost = false;
+	bool clears = false;
+	for (int c = 0; c < count; c++) {
+		scratch.set(cells[c].x, cells[c].y, cells[c].z, &Block::COLORS[type]);
+		lost |= cells[c].y == scratch.getSize().y - 2;
+	}
+
+	for (int c = 0; c < count; c++)
+		clears |= scratch.completesRow(cells[c].x, cells[c].y, cells[c].z);
+
+	float value = LOST;
+	if (!lost && clears) {
+		// Line clears rewrite whole columns, so resolve them on a copy rather than undo them.
+		Grid board(scratch);
+		const int before = board.getScore();
+		for (int c = 0; c < count; c++)
+			board.check(cells[c].x, cells[c].y, cells[c].z);
+		board.removeMarked();
+
+		value = m_heuristic.evaluate(board, board.getScore() - before);
+	}
+	else if (!lost) {
+		value = m_heuristic.evaluate(scratch, 0);
+	}
+
+	for (int c = 0; c < count; c++)
+		scratch.set(cells[c].x, cells[c].y, cells[c].z, nullptr);
+
+	return value;
+}
+
+void Bot::apply(Grid& grid, unsigned type, const Placement& placement) const {
+	Point cells[pieces::MAX_CELLS];
+	const int count = land(grid, type, placement, cells);
+
+	for (int c = 0; c < count; c++)
+		grid.set(cells[c].x, cells[c].y, cells[c].z, &Block::COLORS[type]);
+	for (int c = 0; c < count; c++)
+		grid.check(cells[c].x, cells[c].y, cells[c].z);
+
+	grid.removeMarked();
+}
+
+// Scores the placements the limit leaves, in order; returns whether all of them were scored.
+bool Bot::evaluateAll(const Grid& grid, unsigned type, const std::vector<Placement>& placements, std::vector<float>& scores, Clock::time_point deadline) {
+	const int batch = 16;
+	const int count = std::min<int>(placements.size(), m_remaining);
+	std::vector<std::unique_ptr<Grid>> scratch(m_pool.getThreadCount());
+	std::atomic<int> evaluated(0);
+
+	scores.assign(placements.size(), LOST);
+
+	for (int begin = 0; begin < count; begin += batch) {
+		const int end = std::min(begin + batch, count);
+		m_pool.submit([&, begin, end, type, deadline](int worker) {
+			PROFILE_SCOPE("Bot::evaluate");
+			if (!scratch[worker])
+				scratch[worker].reset(new Grid(grid));
+
+			for (int i = begin; i < end && Clock::now() < deadline; i++) {
+				scores[i] = evaluate(*scratch[worker], type, placements[i]);
+				evaluated++;
+			}
+		});
+	}
+
+	m_pool.wait();
+	m_evaluated += evaluated;
+	m_remaining -= count;
+
+	return evaluated == int(placements.size());
+}
+
+bool Bot::search(const Grid& grid, const Block& current, unsigned next, Placement& best) {
+	PROFILE_SCOPE("Bot::search");
+	const Clock::time_point deadline = m_budget.count() > 0 ? Clock::now() + m_budget : Clock::time_point::max();
+	m_remaining = m_limit > 0 ? m_limit : std::numeric_limits<int>::max();
+
+	Grid base(grid);
+	for (const Point& v : current.getBlocks())
+		base.set(v.x, v.y, v.z, nullptr);
+
+	std::vector<Placement> placements;
+	std::vector<float> scores;
+	enumerate(base, current.getIndex(), placements);
+	if (placements.empty())
+		return false;
+
+	evaluateAll(base, current.getIndex(), placements, scores, deadline);
+
+	std::vector<int> order(placements.size());
+	for (int i = 0; i < int(order.size()); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+
+	best = placements[order[0]];
+
+	// Look one piece ahead from the best boards; a partial look-ahead is not comparable, so it only counts when complete.
+	std::vector<Placement> nextPlacements;
+	std::vector<float> nextScores;
+	float bestTotal = LOST;
+	int bestIndex = -1;
+
+	for (int b = 0; b < BEAM && b < int(order.size()) && scores[order[b]] > LOST; b++) {
+		Grid board(base);
+		apply(board, current.getIndex(), placements[order[b]]);
+
+		enumerate(board, next, nextPlacements);
+		if (!evaluateAll(board, next, nextPlacements, nextScores, deadline))
+			return true;
+
+		const float total = nextScores.empty() ? LOST : *std::max_element(nextScores.begin(), nextScores.end());
+		if (bestIndex < 0 || total > bestTotal) {
+			bestTotal = total;
+			bestIndex = order[b];
+		}
+	}
+
+	if (bestIndex >= 0)
+		best = placements[bestIndex];
+
+	return true;
+}
+
+unsigned Bot::update(const Simulation& simulation) {
+	const Block* block = simulation.getCurrentBlock();
+	if (!block || simulation.isGameOver())
+		return 0;
+
+	if (simulation.getSpawnCount() != m_spawnCount) {
+		m_spawnCount = simulation.getSpawnCount();
+		m_hasTarget = search(simulation.getGrid(), *block, simulation.getNext().getIndex(), m_target);
+		m_stall = 0;
+	}
+
+	if (!m_hasTarget)
+		return COMMAND_DROP;
+
+	const Point& position = block->getPosition();
+	const unsigned char orientation = block->getOrientation();
+
+	if (position.x == m_lastPosition.x && position.z == m_lastPosition.z && orientation == m_lastOrientation)
+		m_stall++;
+	else
+		m_stall = 0;
+
+	m_lastPosition = position;
+	m_lastOrientation = orientation;
+
+	unsigned commands = 0;
+	if (orientation != m_target.orientation)
+		commands |= m_rotationSteps[orientation][m_target.orientation];
+	if (position.x > m_target.x)
+		commands |= COMMAND_LEFT;
+	else if (position.x < m_target.x)
+		commands |= COMMAND_RIGHT;
+	if (position.z > m_target.z)
+		commands |= COMMAND_BACK;
+	else if (position.z < m_target.z)
+		commands |= COMMAND_FORWARD;
+
+	if (!commands || m_stall > STALL_TICKS)
+		return COMMAND_DROP;
+
+	return commands;
+}
+
+int Bot::getEvaluated() const {
+	return m_evaluated;
+}
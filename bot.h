@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include "grid.h"
+#include "block.h"
+#include "pieces.h"
+#include "heuristic.h"
+#include "simulation.h"
+#include "threadpool.h"
+
+// Autoplayer. When a piece spawns it enumerates every orientation and X/Z
+// position the piece can be hard dropped from at spawn height, scores the
+// boards with a Heuristic, and for the best BEAM of them also tries every
+// placement of the next piece. Placements are evaluated in parallel on the pool,
+// each worker on its own copy-on-write copy of the board, and the search stops
+// at the frame budget with the best placement found so far. It then steers the
+// piece with the same commands a player sends.
+// A budget of zero removes the deadline; a limit caps the placements scored per
+// search instead, so the result no longer depends on how fast the search runs.
+class Bot {
+
+public:
+	struct Placement {
+		unsigned char orientation;
+		int x, z;
+	};
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	static const int BEAM = 8;
+	static const int STALL_TICKS = 30;
+
+	ThreadPool& m_pool;
+	const Heuristic& m_heuristic;
+	const std::chrono::microseconds m_budget;
+	const int m_limit;
+	std::vector<unsigned char> m_orientations[pieces::TYPES];
+	unsigned m_rotationSteps[pieces::ORIENTATIONS][pieces::ORIENTATIONS];
+	Placement m_target;
+	bool m_hasTarget;
+	unsigned m_spawnCount;
+	Point m_lastPosition;
+	unsigned char m_lastOrientation;
+	int m_stall;
+	int m_evaluated;
+	int m_remaining;
+
+	void enumerate(const Grid& grid, unsigned type, std::vector<Placement>& placements) const;
+	template <class B>
+	void enumerate(const B& board, const Grid& grid, unsigned type, std::vector<Placement>& placements) const;
+	int land(const Grid& grid, unsigned type, const Placement& placement, Point* cells) const;
+	float evaluate(Grid& scratch, unsigned type, const Placement& placement) const;
+	void apply(Grid& grid, unsigned type, const Placement& placement) const;
+	bool evaluateAll(const Grid& grid, unsigned type, const std::vector<Placement>& placements, std::vector<float>& scores, Clock::time_point deadline);
+
+public:
+	Bot(ThreadPool& pool, const Heuristic& heuristic, double budget = 12.0, int limit = 0);
+
+	unsigned update(const Simulation& simulation);
+	bool search(const Grid& grid, const Block& current, unsigned next, Placement& best);
+
+	int getEvaluated() const;
+
+};
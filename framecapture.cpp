@@ -0,0 +1,254 @@
+#include "framecapture.h"
+
+#include <cstring>
+
+#include "profiler.h"
+
+static bool endsWith(const std::string& text, const char* suffix) {
+	const size_t length = std::strlen(suffix);
+	return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+FrameCapture::FrameCapture(const char* path, int width, int height) : m_path(path), m_width(width), m_height(height), m_video(endsWith(m_path, ".y4m")),
+	m_file(nullptr), m_framebuffer(0), m_color(0), m_depth(0), m_oldest(0), m_pending(0), m_running(true), m_failed(false), m_written(0), m_dropped(0) {
+
+	if (m_video) {
+		m_file = std::fopen(path, "wb");
+		if (m_file)
+			std::fprintf(m_file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", width, height);
+	}
+
+	glGenRenderbuffers(1, &m_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &m_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	const size_t frameSize = size_t(width) * height * 4;
+	for (Readback& readback : m_readbacks) {
+		glGenBuffers(1, &readback.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, nullptr, GL_STREAM_READ);
+		readback.fence = nullptr;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_buffers.resize(BUFFERS, std::vector<unsigned char>(frameSize));
+	for (int i = BUFFERS - 1; i >= 0; i--)
+		m_free.push_back(i);
+
+	m_thread = std::thread(&FrameCapture::run, this);
+}
+
+FrameCapture::~FrameCapture() {
+	finish();
+
+	for (Readback& readback : m_readbacks) {
+		if (readback.fence)
+			glDeleteSync(readback.fence);
+		glDeleteBuffers(1, &readback.buffer);
+	}
+
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteRenderbuffers(1, &m_depth);
+	glDeleteRenderbuffers(1, &m_color);
+
+	if (m_file)
+		std::fclose(m_file);
+}
+
+// Waits for the frames still in flight and for the worker to write them, so a
+// capture ends with the last frame drawn. Later frames are no longer recorded.
+void FrameCapture::finish() {
+	if (!m_thread.joinable())
+		return;
+
+	collect(true);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_condition.notify_one();
+	m_thread.join();
+}
+
+bool FrameCapture::isOpen() const {
+	return !m_video || m_file;
+}
+
+void FrameCapture::begin() {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+void FrameCapture::end(int windowWidth, int windowHeight) {
+	PROFILE_SCOPE("FrameCapture::end");
+	collect(false);
+
+	// A full ring means the GPU is frames behind: skip this one rather than wait.
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	if (m_pending == READBACKS) {
+		m_dropped++;
+	}
+	else if (m_thread.joinable()) {
+		Readback& readback = m_readbacks[(m_oldest + m_pending) % READBACKS];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_pending++;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Hands every finished readback to the worker in order, stopping at the first
+// whose fence has not passed unless told to wait for them.
+void FrameCapture::collect(bool wait) {
+	while (m_pending > 0) {
+		Readback& readback = m_readbacks[m_oldest];
+		const GLenum status = glClientWaitSync(readback.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+		if (status == GL_TIMEOUT_EXPIRED && !wait)
+			return;
+
+		glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+		m_oldest = (m_oldest + 1) % READBACKS;
+		m_pending--;
+
+		if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+			m_dropped++;
+			continue;
+		}
+
+		int target = -1;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_free.empty()) {
+				target = m_free.back();
+				m_free.pop_back();
+			}
+		}
+
+		if (target < 0) {
+			m_dropped++;
+			continue;
+		}
+
+		std::vector<unsigned char>& pixels = m_buffers[target];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		if (const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels.size(), GL_MAP_READ_BIT)) {
+			std::memcpy(pixels.data(), data, pixels.size());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(target);
+		}
+		m_condition.notify_one();
+	}
+}
+
+void FrameCapture::run() {
+	Profiler::setThreadName("capture");
+	int frame = 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_condition.wait(lock, [this] { return !m_queue.empty() || !m_running; });
+		if (m_queue.empty())
+			break;
+
+		const int index = m_queue.front();
+		m_queue.pop_front();
+		lock.unlock();
+
+		encode(m_buffers[index], frame++);
+
+		lock.lock();
+		m_free.push_back(index);
+	}
+}
+
+// GL reads bottom-up; both formats want the top row first. Video frames are
+// converted to studio-range BT.601 Y, Cb and Cr planes.
+void FrameCapture::encode(const std::vector<unsigned char>& pixels, int frame) {
+	PROFILE_SCOPE("FrameCapture::encode");
+	const size_t plane = size_t(m_width) * m_height;
+
+	std::FILE* file = m_file;
+	if (m_video) {
+		m_encoded.resize(plane * 3);
+		unsigned char* y = m_encoded.data();
+		unsigned char* cb = y + plane;
+		unsigned char* cr = cb + plane;
+		for (int row = 0; row < m_height; row++) {
+			const unsigned char* source = pixels.data() + size_t(m_height - 1 - row) * m_width * 4;
+			for (int column = 0; column < m_width; column++, source += 4) {
+				const int r = source[0], g = source[1], b = source[2];
+				*y++ = (unsigned char)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+				*cb++ = (unsigned char)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+				*cr++ = (unsigned char)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+			}
+		}
+	}
+	else {
+		m_encoded.resize(plane * 3);
+		unsigned char* target = m_encoded.data();
+		for (int row = 0; row < m_height; row++) {
+			const unsigned char* source = pixels.data() + size_t(m_height - 1 - row) * m_width * 4;
+			for (int column = 0; column < m_width; column++, source += 4) {
+				*target++ = source[0];
+				*target++ = source[1];
+				*target++ = source[2];
+			}
+		}
+
+		char number[16];
+		std::snprintf(number, sizeof(number), "%06d.ppm", frame);
+		file = std::fopen((m_path + number).c_str(), "wb");
+	}
+
+	bool written = file != nullptr;
+	if (written && m_video)
+		written = std::fputs("FRAME\n", file) >= 0;
+	else if (written)
+		written = std::fprintf(file, "P6\n%d %d\n255\n", m_width, m_height) > 0;
+
+	written = written && std::fwrite(m_encoded.data(), 1, m_encoded.size(), file) == m_encoded.size();
+	if (file && !m_video)
+		written = std::fclose(file) == 0 && written;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (written)
+		m_written++;
+	else
+		m_failed = true;
+}
+
+int FrameCapture::getWidth() const {
+	return m_width;
+}
+
+int FrameCapture::getHeight() const {
+	return m_height;
+}
+
+void FrameCapture::report(std::FILE* file) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::fprintf(file, "capture: %d frames written to %s, %d dropped%s\n", m_written, m_path.c_str(), m_dropped, m_failed ? ", write errors" : "");
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "graphics/render.h"
+
+// Records what the game draws to a video file while it keeps running. Frames
+// are rendered into an offscreen target of a fixed size between begin() and
+// end(), which then shows them scaled in the window and queues an asynchronous
+// readback into a ring of pixel buffers. A readback is collected frames later,
+// once its fence has passed, and a worker thread flips and converts it. If the
+// ring or the worker falls behind, frames are dropped rather than waited for.
+// A path ending in .y4m gets a YUV4MPEG2 4:4:4 stream, stamped at 60 frames per
+// second with one frame per frame drawn. Any other path is a prefix for
+// numbered PPM images, such as "frames/" for frames/000000.ppm.
+class FrameCapture {
+
+public:
+	static const int READBACKS = 3;
+	static const int BUFFERS = 8;
+
+private:
+	struct Readback {
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	std::string m_path;
+	const int m_width;
+	const int m_height;
+	const bool m_video;
+	std::FILE* m_file;
+	GLuint m_framebuffer;
+	GLuint m_color;
+	GLuint m_depth;
+	Readback m_readbacks[READBACKS];
+	int m_oldest;
+	int m_pending;
+	std::vector<std::vector<unsigned char>> m_buffers;
+	std::vector<int> m_free;
+	std::deque<int> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_running;
+	bool m_failed;
+	int m_written;
+	int m_dropped;
+	std::vector<unsigned char> m_encoded;
+	std::thread m_thread;
+
+	void collect(bool wait);
+	void run();
+	void encode(const std::vector<unsigned char>& pixels, int frame);
+
+public:
+	FrameCapture(const char* path, int width, int height);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	bool isOpen() const;
+
+	void begin();
+	void end(int windowWidth, int windowHeight);
+	void finish();
+
+	int getWidth() const;
+	int getHeight() const;
+	void report(std::FILE* file);
+
+};
@@ -0,0 +1,148 @@
+#include "frameoverlay.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "allocations.h"
+
+static const char* const VERTEX_SOURCE =
+	"#version 330 core\n"
+	"layout(location = 0) in vec2 position;\n"
+	"void main() {\n"
+	"	gl_Position = vec4(position, 0.0, 1.0);\n"
+	"}\n";
+
+static const char* const FRAGMENT_SOURCE =
+	"#version 330 core\n"
+	"uniform vec4 barColor;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"	color = barColor;\n"
+	"}\n";
+
+// The histogram box in clip space, and the first bar of frames slower than 60 Hz.
+static const float LEFT = -0.4f;
+static const float RIGHT = 0.4f;
+static const float BOTTOM = 0.55f;
+static const float TOP = 0.85f;
+static const int SLOW_BIN = 17;
+
+static void addQuad(std::vector<float>& vertices, float left, float bottom, float right, float top) {
+	const float quad[] = { left, bottom, right, bottom, right, top, left, bottom, right, top, left, top };
+	vertices.insert(vertices.end(), quad, quad + 12);
+}
+
+FrameOverlay::FrameOverlay(ProgramCache& programs, engine::Font& font, GLint location, float fontSize) : m_font(font), m_text(programs, font, location), m_fontSize(fontSize), m_next(0), m_frames(0), m_gpuTime(0), m_inputLatency(0), m_allocations(0),
+	m_stale(true), m_program(0), m_vao(0), m_vertexBuffer(0), m_colorLocation(-1) {
+
+	m_times.reserve(HISTORY);
+	m_sorted.reserve(HISTORY);
+
+	m_program = programs.build(VERTEX_SOURCE, FRAGMENT_SOURCE);
+	m_colorLocation = glGetUniformLocation(m_program, "barColor");
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (BINS + 1) * 12 * sizeof(float), nullptr, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+FrameOverlay::~FrameOverlay() {
+	glDeleteBuffers(1, &m_vertexBuffer);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteProgram(m_program);
+}
+
+// Times are in milliseconds. The text is refreshed twice a second at 60 fps
+// rather than every frame, which would redraw its texture each time, and only
+// while the overlay is drawn, so a hidden overlay never allocates.
+void FrameOverlay::add(float frameTime, float gpuTime, unsigned long long allocations) {
+	if (int(m_times.size()) < HISTORY)
+		m_times.push_back(frameTime);
+	else
+		m_times[m_next] = frameTime;
+
+	m_next = (m_next + 1) % HISTORY;
+	m_gpuTime = gpuTime;
+	m_allocations = allocations;
+
+	if (m_frames++ % 30 == 0)
+		m_stale = true;
+}
+
+void FrameOverlay::setInputLatency(float latency) {
+	m_inputLatency = latency;
+}
+
+float FrameOverlay::percentile(float fraction) const {
+	if (m_times.empty())
+		return 0;
+
+	m_sorted.assign(m_times.begin(), m_times.end());
+	const size_t index = std::min(m_sorted.size() - 1, size_t(fraction * m_sorted.size()));
+	std::nth_element(m_sorted.begin(), m_sorted.begin() + index, m_sorted.end());
+	return m_sorted[index];
+}
+
+void FrameOverlay::layout() {
+	char line[128];
+	int length = snprintf(line, sizeof(line), "P50 %.1f MS  P99 %.1f MS  GPU %.1f MS", percentile(0.5f), percentile(0.99f), m_gpuTime);
+	if (m_inputLatency > 0)
+		length += snprintf(line + length, sizeof(line) - length, "  INPUT %.1f MS", m_inputLatency);
+	if (Allocations::isTracking())
+		snprintf(line + length, sizeof(line) - length, "  ALLOC %llu", m_allocations);
+
+	m_text.clear();
+	m_text.add(line, 0.5f - m_font.getTextWidth(line, m_fontSize) / 2, (1.0f - TOP) / 2 - m_font.getTextHeight(line, m_fontSize) - 0.01f, m_fontSize);
+}
+
+void FrameOverlay::render(int width, int height) {
+	if (m_stale) {
+		layout();
+		m_stale = false;
+	}
+
+	int counts[BINS] = {};
+	for (float time : m_times)
+		counts[std::min(BINS - 1, std::max(0, int(time)))]++;
+
+	const int highest = std::max(1, *std::max_element(counts, counts + BINS));
+	const float barWidth = (RIGHT - LEFT) / BINS;
+
+	std::vector<float> vertices;
+	vertices.reserve((BINS + 1) * 12);
+	addQuad(vertices, LEFT - 0.01f, BOTTOM - 0.01f, RIGHT + 0.01f, TOP + 0.01f);
+	for (int i = 0; i < BINS; i++)
+		addQuad(vertices, LEFT + i * barWidth, BOTTOM, LEFT + (i + 0.8f) * barWidth, BOTTOM + (TOP - BOTTOM) * counts[i] / highest);
+
+	glViewport(0, 0, width, height);
+
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	glUseProgram(m_program);
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glUniform4f(m_colorLocation, 0.0f, 0.0f, 0.0f, 0.5f);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glUniform4f(m_colorLocation, 1.0f, 1.0f, 1.0f, 0.8f);
+	glDrawArrays(GL_TRIANGLES, 6, SLOW_BIN * 6);
+	glUniform4f(m_colorLocation, 1.0f, 0.3f, 0.2f, 0.8f);
+	glDrawArrays(GL_TRIANGLES, 6 + SLOW_BIN * 6, (BINS - SLOW_BIN) * 6);
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+
+	m_text.render(width, height);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "graphics/gui/font.h"
+
+#include "textlayer.h"
+
+// The frame times of the last HISTORY frames as a histogram of BINS one
+// millisecond bars (the last bar collects everything slower), with the median,
+// the 99th percentile and the GPU time written above it, the median key to
+// photon latency once keys were pressed, and in allocation tracking builds the
+// heap allocations of the last frame.
+class FrameOverlay {
+
+public:
+	static const int HISTORY = 600;
+	static const int BINS = 40;
+
+private:
+	engine::Font& m_font;
+	TextLayer m_text;
+	float m_fontSize;
+	std::vector<float> m_times;
+	mutable std::vector<float> m_sorted;
+	int m_next;
+	int m_frames;
+	float m_gpuTime;
+	float m_inputLatency;
+	unsigned long long m_allocations;
+	bool m_stale;
+	GLuint m_program;
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	GLint m_colorLocation;
+
+	void layout();
+
+public:
+	FrameOverlay(ProgramCache& programs, engine::Font& font, GLint location, float fontSize);
+	~FrameOverlay();
+
+	FrameOverlay(const FrameOverlay&) = delete;
+	FrameOverlay& operator=(const FrameOverlay&) = delete;
+
+	void add(float frameTime, float gpuTime, unsigned long long allocations);
+	void setInputLatency(float latency);
+	float percentile(float fraction) const;
+
+	void render(int width, int height);
+
+};
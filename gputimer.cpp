@@ -0,0 +1,65 @@
+#include "gputimer.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+GpuTimer::GpuTimer() : m_counts(), m_frame(0), m_open(false), m_end(0), m_frameTime(0) {
+	glGenQueries(FRAMES * ZONES, &m_queries[0][0]);
+}
+
+GpuTimer::~GpuTimer() {
+	glDeleteQueries(FRAMES * ZONES, &m_queries[0][0]);
+}
+
+// Zones past ZONES in a frame, and all zones while the profiler is off, are not timed.
+void GpuTimer::begin(const char* name) {
+	int& count = m_counts[m_frame];
+	if (m_open || count == ZONES || !Profiler::isEnabled())
+		return;
+
+	m_zones[m_frame][count] = { name, Profiler::now() };
+	glBeginQuery(GL_TIME_ELAPSED, m_queries[m_frame][count]);
+	m_open = true;
+}
+
+void GpuTimer::end() {
+	if (!m_open)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_counts[m_frame]++;
+	m_open = false;
+}
+
+// The GPU runs the passes back to back after they were submitted, so each zone
+// starts at its submission or at the end of the one before, whichever is later.
+void GpuTimer::resolve(int frame) {
+	uint64_t total = 0;
+
+	for (int i = 0; i < m_counts[frame]; i++) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_queries[frame][i], GL_QUERY_RESULT, &elapsed);
+
+		const uint64_t begin = std::max(m_zones[frame][i].submitted, m_end);
+		m_end = begin + elapsed;
+		total += elapsed;
+		Profiler::record("GPU", m_zones[frame][i].name, begin, m_end);
+	}
+
+	if (m_counts[frame])
+		m_frameTime = total / 1e6f;
+
+	m_counts[frame] = 0;
+}
+
+// Call once per frame after the last zone.
+void GpuTimer::frame() {
+	end();
+	m_frame = (m_frame + 1) % FRAMES;
+	resolve(m_frame);
+}
+
+float GpuTimer::getFrameTime() const {
+	return m_frameTime;
+}
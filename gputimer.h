@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include "graphics/render.h"
+
+// Times render passes with GL_TIME_ELAPSED queries. Zones may not nest, which
+// GL forbids for this query type. Results are read FRAMES frames after they
+// were issued, so reading them does not stall on the GPU, and are recorded to
+// the profiler on the "GPU" track, placed at the time the pass was submitted.
+class GpuTimer {
+
+public:
+	static const int FRAMES = 4;
+	static const int ZONES = 8;
+
+private:
+	struct Zone {
+		const char* name;
+		uint64_t submitted;
+	};
+
+	GLuint m_queries[FRAMES][ZONES];
+	Zone m_zones[FRAMES][ZONES];
+	int m_counts[FRAMES];
+	int m_frame;
+	bool m_open;
+	uint64_t m_end;
+	float m_frameTime;
+
+	void resolve(int frame);
+
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	void begin(const char* name);
+	void end();
+	void frame();
+
+	// Milliseconds the zones of the last resolved frame took together.
+	float getFrameTime() const;
+
+};
+
+class GpuScope {
+
+private:
+	GpuTimer& m_timer;
+
+public:
+	GpuScope(GpuTimer& timer, const char* name) : m_timer(timer) {
+		m_timer.begin(name);
+	}
+
+	~GpuScope() {
+		m_timer.end();
+	}
+
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+
+};
@@ -0,0 +1,542 @@
+#include "grid.h"
+
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#include "profiler.h"
+
+const Color Grid::REMOVE_COLOR = { 0.2f, 0.2f, 0.2f, 1.0f };
+
+// Whether no other copy references the chunk, so it may be written in place.
+// use_count() is a relaxed load; the fence pairs it with the release that
+// dropped the last other reference, so that copy's reads, perhaps on another
+// thread, happen before the writes that follow.
+static bool isSoleOwner(const std::shared_ptr<Grid::Chunk>& chunk) {
+	if (chunk.use_count() != 1)
+		return false;
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return true;
+}
+
+Grid::Grid(Point size) : m_board(size), 
+	m_palette{ nullptr, &REMOVE_COLOR }, m_paletteSize(2), m_lastIndex(0), m_hash(0), m_blockCount(0), m_markedCount(0), 
+	m_removeTimer(StepTimer::milliseconds(300)), m_time(0), m_removeRow(false), m_score(0) {
+
+	const Point& chunks = m_board.getChunkCount();
+	m_chunks.resize(chunks.x * chunks.y * chunks.z);
+	m_rowCountsX.resize(size.y * size.z, 0);
+	m_rowCountsZ.resize(size.y * size.x, 0);
+	m_columnCounts.resize(size.z * size.x, 0);
+	m_heights.resize(size.z * size.x, 0);
+	m_staleHeights.resize(size.z * size.x, false);
+}
+
+Grid::Grid(const Grid& grid) : m_board(grid.m_board), m_chunks(grid.m_chunks), m_paletteSize(grid.m_paletteSize), m_pendingRows(grid.m_pendingRows), 
+	m_rowCountsX(grid.m_rowCountsX), m_rowCountsZ(grid.m_rowCountsZ), m_columnCounts(grid.m_columnCounts), m_heights(grid.m_heights), m_staleHeights(grid.m_staleHeights), 
+	m_lastIndex(grid.m_lastIndex), m_hash(grid.m_hash), m_blockCount(grid.m_blockCount), m_markedCount(grid.m_markedCount), 
+	m_removeTimer(grid.m_removeTimer), m_time(grid.m_time), m_removeRow(grid.m_removeRow), m_score(grid.m_score) {
+
+	std::copy(grid.m_palette, grid.m_palette + PALETTE_SIZE, m_palette);
+}
+
+Grid& Grid::operator=(const Grid& grid) {
+	// The free list and the column scratch stay with this grid.
+	m_board = grid.m_board;
+	m_chunks = grid.m_chunks;
+	std::copy(grid.m_palette, grid.m_palette + PALETTE_SIZE, m_palette);
+	m_paletteSize = grid.m_paletteSize;
+	// Grown to the capacity of the source, so a copy refreshed every tick only reallocates when the source did.
+	m_pendingRows.reserve(grid.m_pendingRows.capacity());
+	m_pendingRows = grid.m_pendingRows;
+	m_rowCountsX = grid.m_rowCountsX;
+	m_rowCountsZ = grid.m_rowCountsZ;
+	m_columnCounts = grid.m_columnCounts;
+	m_heights = grid.m_heights;
+	m_staleHeights = grid.m_staleHeights;
+	m_lastIndex = grid.m_lastIndex;
+	m_hash = grid.m_hash;
+	m_blockCount = grid.m_blockCount;
+	m_markedCount = grid.m_markedCount;
+	m_removeTimer = grid.m_removeTimer;
+	m_time = grid.m_time;
+	m_removeRow = grid.m_removeRow;
+	m_score = grid.m_score;
+	return *this;
+}
+
+// Takes the chunks no other copy references from stale into the free list,
+// leaving stale without them; stale must be assigned to before it is used again.
+void Grid::reclaim(Grid& stale) {
+	for (std::shared_ptr<Chunk>& chunk : stale.m_chunks)
+		if (chunk && isSoleOwner(chunk))
+			m_freeChunks.push_back(std::move(chunk));
+}
+
+uint64_t Grid::cellKey(int x, int y, int z, unsigned char color) {
+	uint64_t key = ((uint64_t(y) << 42 | uint64_t(z) << 21 | uint64_t(x)) << 8 | color) + 0x9E3779B97F4A7C15ull;
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+	return key ^ (key >> 31);
+}
+
+unsigned char Grid::paletteIndex(const Color* color) {
+	if (!color)
+		return 0;
+
+	if (m_palette[m_lastIndex] == color)
+		return m_lastIndex;
+
+	for (int i = 0; i < m_paletteSize; i++)
+		if (m_palette[i] == color)
+			return m_lastIndex = i;
+
+	if (m_paletteSize == PALETTE_SIZE)
+		return m_lastIndex = PALETTE_SIZE - 1;
+
+	m_palette[m_paletteSize] = color;
+	return m_lastIndex = m_paletteSize++;
+}
+
+void Grid::tick() {
+	m_time++;
+}
+
+void Grid::update() {
+	if (m_removeRow)
+		if (m_removeTimer.ready(m_time))
+			remove();
+}
+
+void Grid::set(int x, int y, int z, const Color* color) {
+	const unsigned char colorIndex = paletteIndex(color);
+	std::shared_ptr<Chunk>& slot = m_chunks[m_board.chunk(x, y, z)];
+
+	if (!slot) {
+		if (!colorIndex)
+			return;
+
+		if (m_freeChunks.empty()) {
+			slot = std::make_shared<Chunk>();
+		}
+		else {
+			slot = std::move(m_freeChunks.back());
+			m_freeChunks.pop_back();
+		}
+
+		std::memset(slot.get(), 0, sizeof(Chunk));
+	}
+
+	const int local = Board<>::local(x, y, z);
+	const unsigned char previous = slot->colors[local];
+
+	if (previous == colorIndex)
+		return;
+
+	if (!isSoleOwner(slot)) {
+		if (m_freeChunks.empty()) {
+			slot = std::make_shared<Chunk>(*slot);
+		}
+		else {
+			std::shared_ptr<Chunk> copy = std::move(m_freeChunks.back());
+			m_freeChunks.pop_back();
+			*copy = *slot;
+			slot = std::move(copy);
+		}
+	}
+
+	Chunk& chunk = *slot;
+
+	uint64_t key = 0;
+	if (previous)
+		key ^= cellKey(x, y, z, previous);
+	if (colorIndex)
+		key ^= cellKey(x, y, z, colorIndex);
+
+	m_hash ^= key;
+	chunk.layerHashes[y & (CHUNK_SIZE - 1)] ^= key;
+	chunk.colors[local] = colorIndex;
+
+	const int filled = (colorIndex != 0) - (previous != 0);
+	const int marked = (colorIndex == 1) - (previous == 1);
+	chunk.count += filled;
+	chunk.layerCounts[y & (CHUNK_SIZE - 1)] += filled;
+	chunk.markedCount += marked;
+	m_blockCount += filled;
+	m_markedCount += marked;
+
+	bits::set(chunk.occupancy, local, colorIndex != 0);
+	bits::set(chunk.marked, local, colorIndex == 1);
+
+	if (filled) {
+		const Point& size = m_board.getSize();
+		if (x > 0 && x < size.x - 1)
+			m_rowCountsX[m_board.rowX(y, z)] += filled;
+		if (z > 0 && z < size.z - 1)
+			m_rowCountsZ[m_board.rowZ(y, x)] += filled;
+
+		const int column = m_board.column(x, z);
+		m_columnCounts[column] += filled;
+		if (filled > 0 && y >= m_heights[column] - 1) {
+			m_heights[column] = std::max(m_heights[column], y + 1);
+			if (y == m_heights[column] - 1)
+				m_staleHeights[column] = false;
+		}
+		else if (filled < 0 && y == m_heights[column] - 1) {
+			m_staleHeights[column] = true;
+		}
+	}
+
+	if (chunk.count == 0) {
+		if (isSoleOwner(slot))
+			m_freeChunks.push_back(std::move(slot));
+		else
+			slot.reset();
+	}
+}
+
+const Color* Grid::get(int x, int y, int z) const {
+	const Chunk* chunk = m_chunks[m_board.chunk(x, y, z)].get();
+	return chunk ? m_palette[chunk->colors[Board<>::local(x, y, z)]] : nullptr;
+}
+
+bool Grid::isSolid(int x, int y, int z) const {
+	return isSolid(m_board, x, y, z);
+}
+
+int Grid::getHeight(int x, int z) const {
+	const int column = m_board.column(x, z);
+	if (m_staleHeights[column]) {
+		int& height = m_heights[column];
+		while (height > 0 && !isSolid(x, height - 1, z))
+			height--;
+
+		m_staleHeights[column] = false;
+	}
+
+	return m_heights[column];
+}
+
+int Grid::getColumnCount(int x, int z) const {
+	return m_columnCounts[m_board.column(x, z)];
+}
+
+int Grid::dropDistance(int x, int y, int z) const {
+	const int height = getHeight(x, z);
+	if (height <= y)
+		return y - height;
+
+	int distance = 0;
+	while (!isSolid(x, y - distance - 1, z))
+		distance++;
+
+	return distance;
+}
+
+void Grid::remove() {
+	PROFILE_SCOPE("Grid::remove");
+	m_removeRow = false;
+
+	// Every column crossed by a marked row is collapsed once, from its lowest marked cell up.
+	const Point& size = m_board.getSize();
+	m_clearColumns.clear();
+	for (const Row& row : m_pendingRows) {
+		if (row.alongX) {
+			for (int i = 1; i < size.x - 1; i++)
+				m_clearColumns.push_back(std::make_pair(m_board.column(i, row.position), row.y));
+		}
+		else {
+			for (int i = 1; i < size.z - 1; i++)
+				m_clearColumns.push_back(std::make_pair(m_board.column(row.position, i), row.y));
+		}
+	}
+
+	m_pendingRows.clear();
+
+	std::sort(m_clearColumns.begin(), m_clearColumns.end());
+
+	int count = 0;
+	for (int i = 0; i < int(m_clearColumns.size()); i++)
+		if (i == 0 || m_clearColumns[i].first != m_clearColumns[i - 1].first)
+			count += collapseColumn(m_clearColumns[i].first % size.x, m_clearColumns[i].second, m_clearColumns[i].first / size.x);
+
+	addScore(count * count);
+}
+
+int Grid::collapseColumn(int x, int bottom, int z) {
+	// Same result as shifting the column down once per marked cell: the top layer refills the gap.
+	const int height = m_board.getSize().y;
+	int write = bottom;
+	for (int l = bottom; l < height - 1; l++) {
+		const Color* color = get(x, l, z);
+		if (color == &REMOVE_COLOR)
+			continue;
+
+		if (write != l)
+			set(x, write, z, color);
+		write++;
+	}
+
+	const int count = (height - 1) - write;
+	const Color* top = get(x, height - 1, z);
+	for (; write < height - 1; write++)
+		set(x, write, z, top);
+
+	return count;
+}
+
+bool Grid::check(int x, int y, int z) {
+	const Point& size = m_board.getSize();
+	bool ready = false;
+
+	if (m_rowCountsZ[m_board.rowZ(y, x)] == size.z - 2) {
+		m_removeRow = true;
+		m_removeTimer.reset(m_time);
+		for (int i = 1; i < size.z - 1; i++)
+			set(x, y, i, &REMOVE_COLOR);
+
+		m_pendingRows.push_back({ false, y, x });
+
+		ready = true;
+	}
+
+	if (m_rowCountsX[m_board.rowX(y, z)] == size.x - 2) {
+		m_removeRow = true;
+		m_removeTimer.reset(m_time);
+		for (int i = 1; i < size.x - 1; i++)
+			set(i, y, z, &REMOVE_COLOR);
+
+		m_pendingRows.push_back({ true, y, z });
+
+		ready = true;
+	}
+
+	return ready;
+}
+
+bool Grid::completesRow(int x, int y, int z) const {
+	const Point& size = m_board.getSize();
+	return m_rowCountsZ[m_board.rowZ(y, x)] == size.z - 2 || m_rowCountsX[m_board.rowX(y, z)] == size.x - 2;
+}
+
+void Grid::removeMarked() {
+	if (m_removeRow)
+		remove();
+}
+
+void Grid::clear() {
+	const Point& size = m_board.getSize();
+	const Point& chunks = m_board.getChunkCount();
+	for (int index = 0; index < int(m_chunks.size()); index++) {
+		const int cx = index % chunks.x;
+		const int cz = (index / chunks.x) % chunks.z;
+		const int cy = index / (chunks.x * chunks.z);
+
+		for (int w = 0; m_chunks[index] && w < CHUNK_WORDS; w++) {
+			for (uint64_t word = m_chunks[index]->occupancy[w]; word; word &= word - 1) {
+				const int local = w * 64 + bits::lowest(word);
+				const int x = (cx << CHUNK_BITS) | (local & (CHUNK_SIZE - 1));
+				const int z = (cz << CHUNK_BITS) | ((local >> CHUNK_BITS) & (CHUNK_SIZE - 1));
+				const int y = (cy << CHUNK_BITS) | (local >> (2 * CHUNK_BITS));
+
+				if (x >= 1 && x < size.x - 1 && y >= 1 && y < size.y - 1 && z < size.z - 1)
+					set(x, y, z, nullptr);
+
+				if (!m_chunks[index])
+					break;
+			}
+		}
+	}
+
+	m_pendingRows.clear();
+	m_removeRow = false;
+}
+
+// The size, the palette as indices into colors, then every Y layer as runs of
+// (length, palette index) along X then Z, then the rows waiting for removal and
+// the clock. Walls and empty space collapse into a few runs per layer. Fails if
+// the palette holds a color missing from colors.
+bool Grid::save(StateWriter& writer, const Color* const colors[], int colorCount) const {
+	const Point& size = m_board.getSize();
+	writer.write(size.x);
+	writer.write(size.y);
+	writer.write(size.z);
+
+	writer.write(m_paletteSize);
+	for (int i = 2; i < m_paletteSize; i++) {
+		const int id = int(std::find(colors, colors + colorCount, m_palette[i]) - colors);
+		if (id == colorCount)
+			return false;
+
+		writer.write(id);
+	}
+
+	for (int y = 0; y < size.y; y++) {
+		int run = 0;
+		unsigned char previous = 0;
+		for (int z = 0; z < size.z; z++) {
+			for (int x = 0; x < size.x; x++) {
+				const Chunk* chunk = m_chunks[m_board.chunk(x, y, z)].get();
+				const unsigned char index = chunk ? chunk->colors[Board<>::local(x, y, z)] : 0;
+				if (index != previous && run > 0) {
+					writer.write(run);
+					writer.write(previous);
+					run = 0;
+				}
+
+				previous = index;
+				run++;
+			}
+		}
+
+		writer.write(run);
+		writer.write(previous);
+	}
+
+	writer.write(m_pendingRows.size());
+	for (const Row& row : m_pendingRows) {
+		writer.write(row.alongX);
+		writer.write(row.y);
+		writer.write(row.position);
+	}
+
+	writer.write(m_removeTimer.getDelay());
+	writer.write(m_removeTimer.getLast());
+	writer.write(m_time);
+	writer.write(m_removeRow);
+	writer.writeSigned(m_score);
+	return true;
+}
+
+// Rebuilds the grid cell by cell with the palette in its saved order, so the
+// counters and the hash come out as they were. The grid is left untouched if
+// the state is invalid.
+bool Grid::restore(StateReader& reader, const Color* const colors[], int colorCount) {
+	const uint64_t x = reader.read(), y = reader.read(), z = reader.read();
+	if (!reader.isValid() || x == 0 || y == 0 || z == 0 || x > 1024 || y > 1024 || z > 1024) {
+		reader.fail();
+		return false;
+	}
+
+	Grid grid({ int(x), int(y), int(z) });
+
+	const uint64_t paletteSize = reader.read();
+	if (paletteSize < 2 || paletteSize > PALETTE_SIZE) {
+		reader.fail();
+		return false;
+	}
+
+	for (int i = 2; i < int(paletteSize); i++) {
+		const uint64_t id = reader.read();
+		if (id >= uint64_t(colorCount) || !colors[id] || std::find(grid.m_palette, grid.m_palette + i, colors[id]) != grid.m_palette + i) {
+			reader.fail();
+			return false;
+		}
+
+		grid.m_palette[i] = colors[id];
+	}
+
+	grid.m_paletteSize = int(paletteSize);
+
+	const int layer = int(x * z);
+	for (int l = 0; l < int(y); l++) {
+		for (int cell = 0; cell < layer;) {
+			const uint64_t run = reader.read();
+			const uint64_t index = reader.read();
+			if (!reader.isValid() || run == 0 || run > uint64_t(layer - cell) || index >= paletteSize) {
+				reader.fail();
+				return false;
+			}
+
+			if (index)
+				for (int i = cell; i < cell + int(run); i++)
+					grid.set(i % int(x), l, i / int(x), grid.m_palette[index]);
+
+			cell += int(run);
+		}
+	}
+
+	const uint64_t rows = reader.read();
+	if (rows > 2 * y * std::max(x, z)) {
+		reader.fail();
+		return false;
+	}
+
+	for (uint64_t i = 0; i < rows; i++) {
+		const uint64_t alongX = reader.read(), row = reader.read(), position = reader.read();
+		if (alongX > 1 || row >= y || position >= (alongX ? z : x)) {
+			reader.fail();
+			return false;
+		}
+
+		grid.m_pendingRows.push_back({ alongX == 1, int(row), int(position) });
+	}
+
+	const uint64_t delay = reader.read(), last = reader.read(), time = reader.read(), removeRow = reader.read();
+	const int64_t score = reader.readSigned();
+	if (!reader.isValid() || delay > UINT32_MAX || last > UINT32_MAX || time > UINT32_MAX || removeRow > 1 || score < INT32_MIN || score > INT32_MAX) {
+		reader.fail();
+		return false;
+	}
+
+	grid.m_removeTimer = StepTimer(unsigned(delay), unsigned(last));
+	grid.m_time = unsigned(time);
+	grid.m_removeRow = removeRow == 1;
+	grid.m_score = int(score);
+	*this = grid;
+	return true;
+}
+
+bool Grid::isReady() const {
+	return m_markedCount == 0;
+}
+
+int Grid::getBlockCount() const {
+	return m_blockCount;
+}
+
+const Grid::Chunk* Grid::getChunk(int cx, int cy, int cz) const {
+	const Point& chunks = m_board.getChunkCount();
+	if (cx < 0 || cy < 0 || cz < 0 || cx >= chunks.x || cy >= chunks.y || cz >= chunks.z)
+		return nullptr;
+
+	return m_chunks[(cy * chunks.z + cz) * chunks.x + cx].get();
+}
+
+const Point& Grid::getChunkCount() const {
+	return m_board.getChunkCount();
+}
+
+int Grid::getChunkMemory() const {
+	int count = m_freeChunks.size();
+	for (const std::shared_ptr<Chunk>& chunk : m_chunks)
+		if (chunk)
+			count++;
+
+	return count * sizeof(Chunk);
+}
+
+uint64_t Grid::getHash() const {
+	return m_hash;
+}
+
+const Point& Grid::getSize() const {
+	return m_board.getSize();
+}
+
+const Board<>& Grid::getBoard() const {
+	return m_board;
+}
+
+unsigned Grid::getTime() const {
+	return m_time;
+}
+
+void Grid::addScore(int score) {
+	m_score += score;
+}
+
+int Grid::getScore() const {
+	return m_score;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "bits.h"
+#include "board.h"
+#include "savestate.h"
+#include "steptimer.h"
+
+struct Color {
+	float r, g, b, a;
+};
+
+// Cells are stored in 16x16x16 chunks that only exist while they hold a block.
+// A chunk keeps one occupancy bit per cell (bit (y * 16 + z) * 16 + x, so a row
+// along X is 16 contiguous bits and a Y layer is four words), a second bitboard
+// for cells marked for removal, and a one byte index into a small color palette.
+// Index 0 is empty, 1 is REMOVE_COLOR. The palette is a fixed array, so copies
+// carry it without allocating; colors past PALETTE_SIZE are drawn with the
+// last one.
+// m_hash is the XOR of a key per non-empty cell and color, so it only changes
+// when the contents do: erasing and redrawing a piece in place cancels out.
+// Every chunk keeps the same XOR per local Y layer, next to the cell count of
+// each layer, so a mesher can tell which layers changed.
+// m_rowCountsX (per y, z) and m_rowCountsZ (per y, x) count the filled interior
+// cells of each row and m_heights holds one past the top filled cell of every
+// column, so full rows and drop distances are lookups. Removing the top cell of
+// a column only flags its height as an upper bound; it is rescanned on the next
+// query, so a piece erased and redrawn every tick costs nothing here.
+// Copies share chunks until one side writes to them, which makes a snapshot for
+// search or a replay keyframe cost only the counter arrays. Each copy may live
+// on its own thread, written there while other threads read or drop theirs: a
+// chunk is written in place only once this copy is its sole owner, checked with
+// acquire ordering, and copied first otherwise. A single copy must not be used
+// from two threads while either of them writes to it.
+// Chunks emptied or reclaim()ed from a copy about to be overwritten go to a
+// free list, and copies on write take from it, so a grid copied out every tick
+// stays off the heap.
+class Grid {
+
+public:
+	static const int CHUNK_BITS = Board<>::CHUNK_BITS;
+	static const int CHUNK_SIZE = Board<>::CHUNK_SIZE;
+	static const int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+	static const int CHUNK_WORDS = CHUNK_CELLS / 64;
+	static const int PALETTE_SIZE = 16;
+
+	struct Chunk {
+		uint64_t occupancy[CHUNK_WORDS];
+		uint64_t marked[CHUNK_WORDS];
+		uint64_t layerHashes[CHUNK_SIZE];
+		int layerCounts[CHUNK_SIZE];
+		unsigned char colors[CHUNK_CELLS];
+		int count;
+		int markedCount;
+	};
+
+private:
+	// A row marked by check(): along X at (y, position = z) or along Z at (y, position = x).
+	struct Row {
+		bool alongX;
+		int y;
+		int position;
+	};
+
+	Board<> m_board;
+	std::vector<std::shared_ptr<Chunk>> m_chunks;
+	std::vector<std::shared_ptr<Chunk>> m_freeChunks;
+	const Color* m_palette[PALETTE_SIZE];
+	int m_paletteSize;
+	std::vector<Row> m_pendingRows;
+	std::vector<std::pair<int, int>> m_clearColumns;
+	std::vector<int> m_rowCountsX;
+	std::vector<int> m_rowCountsZ;
+	std::vector<int> m_columnCounts;
+	mutable std::vector<int> m_heights;
+	mutable std::vector<unsigned char> m_staleHeights;
+	unsigned char m_lastIndex;
+	uint64_t m_hash;
+	int m_blockCount;
+	int m_markedCount;
+	StepTimer m_removeTimer;
+	unsigned m_time;
+	bool m_removeRow;
+	int m_score;
+
+	static uint64_t cellKey(int x, int y, int z, unsigned char color);
+	unsigned char paletteIndex(const Color* color);
+	void remove();
+	int collapseColumn(int x, int bottom, int z);
+
+public:
+	static const Color REMOVE_COLOR;
+
+	Grid(Point size);
+	Grid(const Grid& grid);
+
+	Grid& operator=(const Grid& grid);
+	void reclaim(Grid& stale);
+
+	void tick();
+	void update();
+
+	void set(int x, int y, int z, const Color* color);
+	const Color* get(int x, int y, int z) const;
+	bool isSolid(int x, int y, int z) const;
+	template <class B>
+	bool isSolid(const B& board, int x, int y, int z) const;
+	int getHeight(int x, int z) const;
+	int getColumnCount(int x, int z) const;
+	int dropDistance(int x, int y, int z) const;
+	bool check(int x, int y, int z);
+	bool completesRow(int x, int y, int z) const;
+	void removeMarked();
+	void clear();
+
+	bool save(StateWriter& writer, const Color* const colors[], int colorCount) const;
+	bool restore(StateReader& reader, const Color* const colors[], int colorCount);
+
+	bool isReady() const;
+	int getBlockCount() const;
+	const Chunk* getChunk(int cx, int cy, int cz) const;
+	const Point& getChunkCount() const;
+	int getChunkMemory() const;
+	uint64_t getHash() const;
+	const Point& getSize() const;
+	const Board<>& getBoard() const;
+	unsigned getTime() const;
+	void addScore(int score);
+	int getScore() const;
+
+};
+
+// The probe of isSolid() with the index arithmetic of the given board, which
+// must have this grid's size. Out of bounds cells are solid.
+template <class B>
+bool Grid::isSolid(const B& board, int x, int y, int z) const {
+	if (!board.contains(x, y, z))
+		return true;
+
+	const Chunk* chunk = m_chunks[board.chunk(x, y, z)].get();
+	return chunk && bits::test(chunk->occupancy, B::local(x, y, z));
+}
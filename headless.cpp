@@ -0,0 +1,212 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "simulation.h"
+#include "random.h"
+#include "bot.h"
+#include "batchrunner.h"
+#include "replay.h"
+#include "replayplayer.h"
+
+static void printDistribution(const char* name, std::vector<double> values) {
+	if (values.empty())
+		return;
+
+	std::sort(values.begin(), values.end());
+
+	double total = 0;
+	for (double value : values)
+		total += value;
+
+	const double low = values.front();
+	const double high = values.back();
+
+	std::printf("%s mean: %.2f\n", name, total / values.size());
+	std::printf("%s min: %.0f\n", name, low);
+	std::printf("%s p10: %.0f\n", name, values[values.size() / 10]);
+	std::printf("%s p50: %.0f\n", name, values[values.size() / 2]);
+	std::printf("%s p90: %.0f\n", name, values[values.size() * 9 / 10]);
+	std::printf("%s p99: %.0f\n", name, values[values.size() * 99 / 100]);
+	std::printf("%s max: %.0f\n", name, high);
+
+	const int buckets = 10;
+	int counts[buckets] = {};
+	for (double value : values)
+		counts[high > low ? std::min(buckets - 1, int((value - low) / (high - low) * buckets)) : 0]++;
+
+	for (int i = 0; i < buckets; i++)
+		std::printf("%s histogram %.0f-%.0f: %d\n", name, low + (high - low) * i / buckets, low + (high - low) * (i + 1) / buckets, counts[i]);
+}
+
+// Usage: headless batch [games] [seed] [size] [height] [max ticks] [bot]
+static int runBatch(int argc, char** argv) {
+	const int games = argc > 1 ? std::atoi(argv[1]) : 1000;
+	const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+	const int size = argc > 3 ? std::atoi(argv[3]) : 12;
+	const int height = argc > 4 ? std::atoi(argv[4]) : 21;
+	const unsigned maxTicks = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 100000;
+	const bool autoplay = argc > 6 && std::strcmp(argv[6], "bot") == 0;
+
+	ThreadPool pool;
+	const BatchRunner::Result result = BatchRunner(games, seed, size, height, maxTicks, autoplay).run(pool);
+
+	std::printf("games: %d\n", games);
+	std::printf("threads: %d\n", pool.getThreadCount());
+	std::printf("seconds: %.3f\n", result.seconds);
+	std::printf("games/s: %.1f\n", games / result.seconds);
+	std::printf("ticks/s: %.0f\n", result.ticks / result.seconds);
+
+	printDistribution("score", std::vector<double>(result.scores.begin(), result.scores.end()));
+	printDistribution("length", std::vector<double>(result.lengths.begin(), result.lengths.end()));
+	printDistribution("pieces", std::vector<double>(result.pieces.begin(), result.pieces.end()));
+
+	return 0;
+}
+
+// Usage: headless replay <file> [seek tick]
+static int runReplay(int argc, char** argv) {
+	Replay replay;
+	if (argc < 2 || !replay.load(argv[1])) {
+		std::fprintf(stderr, "cannot read replay %s\n", argc > 1 ? argv[1] : "");
+		return 1;
+	}
+
+	ReplayPlayer player(replay);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	if (argc > 2)
+		player.seek(std::strtoul(argv[2], nullptr, 10));
+	else
+		player.fastForward(replay.getTicks());
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const Simulation& simulation = player.getSimulation();
+
+	std::printf("ticks: %u\n", player.getTick());
+	std::printf("seconds: %.3f\n", seconds);
+	std::printf("ticks/s: %.0f\n", player.getTick() / seconds);
+	std::printf("score: %d\n", simulation.getGrid().getScore());
+	std::printf("high score: %d\n", simulation.getHighScore());
+	std::printf("pieces: %u\n", simulation.getSpawnCount());
+	std::printf("hash: %016llx\n", (unsigned long long)simulation.getGrid().getHash());
+
+	return 0;
+}
+
+// Runs the game rules without a window or GL context as fast as possible, with
+// random input or, given "bot", the autoplayer. "batch" plays many games instead,
+// "record <file>" saves the run as a replay and "replay" plays one back.
+// "resume <state>" starts from a saved state instead of a new game and
+// "checkpoint <state>" saves the final one, so runs can branch from one position.
+// Usage: headless [record <file>] [resume <state>] [checkpoint <state>] [ticks] [seed] [size] [height] [bot]
+int main(int argc, char** argv) {
+	if (argc > 1 && std::strcmp(argv[1], "batch") == 0)
+		return runBatch(argc - 1, argv + 1);
+
+	if (argc > 1 && std::strcmp(argv[1], "replay") == 0)
+		return runReplay(argc - 1, argv + 1);
+
+	const char* recordPath = nullptr;
+	const char* resumePath = nullptr;
+	const char* checkpointPath = nullptr;
+	for (; argc > 2; argc -= 2, argv += 2) {
+		if (std::strcmp(argv[1], "record") == 0)
+			recordPath = argv[2];
+		else if (std::strcmp(argv[1], "resume") == 0)
+			resumePath = argv[2];
+		else if (std::strcmp(argv[1], "checkpoint") == 0)
+			checkpointPath = argv[2];
+		else
+			break;
+	}
+
+	// A replay is played from its seed, which a resumed game no longer follows.
+	if (recordPath && resumePath) {
+		std::fprintf(stderr, "cannot record a resumed game\n");
+		return 1;
+	}
+
+	const unsigned long long ticks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+	const int size = argc > 3 ? std::atoi(argv[3]) : 12;
+	const int height = argc > 4 ? std::atoi(argv[4]) : 21;
+	const bool autoplay = argc > 5 && std::strcmp(argv[5], "bot") == 0;
+
+	ThreadPool pool;
+	DefaultHeuristic heuristic;
+	Bot bot(pool, heuristic);
+
+	Simulation simulation(size, height, seed);
+	if (resumePath && !simulation.load(resumePath)) {
+		std::fprintf(stderr, "cannot read state %s\n", resumePath);
+		return 1;
+	}
+
+	Random input(seed ^ 0x5DEECE66Dull);
+	Replay replay(size, height, seed);
+
+	unsigned long long games = 0;
+	long long totalScore = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned long long tick = 0; tick < ticks; tick++) {
+		unsigned commands = 0;
+		if (autoplay) {
+			commands = bot.update(simulation);
+		}
+		else {
+			const uint64_t roll = input.nextInt();
+			if ((roll & 0x7) == 0)
+				commands |= 1u << ((roll >> 3) % 7);
+		}
+
+		if (simulation.isGameOver())
+			commands |= COMMAND_RESTART;
+
+		if (recordPath)
+			replay.record(commands);
+
+		simulation.update(commands);
+
+		if (simulation.isGameOver() && !(commands & COMMAND_RESTART)) {
+			games++;
+			totalScore += simulation.getHighScore();
+		}
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("ticks: %llu\n", ticks);
+	std::printf("seconds: %.3f\n", seconds);
+	std::printf("ticks/s: %.0f\n", ticks / seconds);
+	std::printf("games: %llu\n", games);
+	std::printf("mean score: %.2f\n", games ? double(totalScore) / games : 0.0);
+	std::printf("score: %d\n", simulation.getGrid().getScore());
+	std::printf("pieces: %u\n", simulation.getSpawnCount());
+	if (autoplay)
+		std::printf("placements evaluated: %d\n", bot.getEvaluated());
+
+	if (recordPath || resumePath || checkpointPath)
+		std::printf("hash: %016llx\n", (unsigned long long)simulation.getGrid().getHash());
+
+	if (checkpointPath && !simulation.save(checkpointPath)) {
+		std::fprintf(stderr, "cannot write state %s\n", checkpointPath);
+		return 1;
+	}
+
+	if (recordPath) {
+		std::printf("replay bytes: %u\n", unsigned(replay.getStreamSize()));
+		if (!replay.save(recordPath)) {
+			std::fprintf(stderr, "cannot write replay %s\n", recordPath);
+			return 1;
+		}
+	}
+
+	return 0;
+}
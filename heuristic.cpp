@@ -0,0 +1,31 @@
+#include "heuristic.h"
+
+#include <cstdlib>
+
+DefaultHeuristic::DefaultHeuristic() : heightWeight(-0.5f), maxHeightWeight(-1.0f), holeWeight(-4.0f), bumpinessWeight(-0.25f), scoreWeight(2.0f) {
+}
+
+float DefaultHeuristic::evaluate(const Grid& grid, int score) const {
+	const Point& size = grid.getSize();
+	int height = 0;
+	int maxHeight = 0;
+	int holes = 0;
+	int bumpiness = 0;
+
+	for (int k = 1; k < size.z - 1; k++) {
+		for (int i = 1; i < size.x - 1; i++) {
+			const int column = grid.getHeight(i, k);
+			height += column;
+			holes += column - grid.getColumnCount(i, k);
+			if (column > maxHeight)
+				maxHeight = column;
+			if (i + 1 < size.x - 1)
+				bumpiness += std::abs(column - grid.getHeight(i + 1, k));
+			if (k + 1 < size.z - 1)
+				bumpiness += std::abs(column - grid.getHeight(i, k + 1));
+		}
+	}
+
+	const float columns = float((size.x - 2) * (size.z - 2));
+	return heightWeight * height / columns + maxHeightWeight * maxHeight + holeWeight * holes + bumpinessWeight * bumpiness / columns + scoreWeight * score;
+}
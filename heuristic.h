@@ -0,0 +1,32 @@
+#pragma once
+
+#include "grid.h"
+
+// Scores a board for the bot; higher is better. `score` is the points the
+// placement just earned through cleared rows.
+class Heuristic {
+
+public:
+	virtual ~Heuristic() {}
+
+	virtual float evaluate(const Grid& grid, int score) const = 0;
+
+};
+
+// Weighted sum over the interior columns: aggregate and maximum stack height,
+// holes (empty cells under a column's top), bumpiness between neighbouring
+// columns, and cleared-row points.
+class DefaultHeuristic : public Heuristic {
+
+public:
+	float heightWeight;
+	float maxHeightWeight;
+	float holeWeight;
+	float bumpinessWeight;
+	float scoreWeight;
+
+	DefaultHeuristic();
+
+	float evaluate(const Grid& grid, int score) const override;
+
+};
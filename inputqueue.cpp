@@ -0,0 +1,75 @@
+#include "inputqueue.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+InputQueue::InputQueue() : m_head(0), m_tail(0), m_dropped(0) {
+}
+
+bool InputQueue::push(const InputEvent& event) {
+	const unsigned head = m_head.load(std::memory_order_relaxed);
+	if (head - m_tail.load(std::memory_order_acquire) == CAPACITY) {
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	m_events[head % CAPACITY] = event;
+	m_head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputQueue::peek(InputEvent& event) const {
+	const unsigned tail = m_tail.load(std::memory_order_relaxed);
+	if (tail == m_head.load(std::memory_order_acquire))
+		return false;
+
+	event = m_events[tail % CAPACITY];
+	return true;
+}
+
+// Only after a successful peek().
+void InputQueue::pop() {
+	m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+unsigned InputQueue::getDropped() const {
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+InputLatency::InputLatency() : m_next(0), m_count(0), m_max(0) {
+	m_times.reserve(HISTORY);
+	m_sorted.reserve(HISTORY);
+}
+
+void InputLatency::add(const InputEvent& event, uint64_t shown) {
+	Profiler::record("input", "key to photon", event.time, shown);
+
+	const float time = (shown - event.time) / 1e6f;
+	if (int(m_times.size()) < HISTORY)
+		m_times.push_back(time);
+	else
+		m_times[m_next] = time;
+
+	m_next = (m_next + 1) % HISTORY;
+	m_max = std::max(m_max, time);
+	m_count++;
+}
+
+float InputLatency::percentile(float fraction) const {
+	if (m_times.empty())
+		return 0;
+
+	m_sorted.assign(m_times.begin(), m_times.end());
+	const size_t index = std::min(m_sorted.size() - 1, size_t(fraction * m_sorted.size()));
+	std::nth_element(m_sorted.begin(), m_sorted.begin() + index, m_sorted.end());
+	return m_sorted[index];
+}
+
+int InputLatency::getCount() const {
+	return m_count;
+}
+
+void InputLatency::report(std::FILE* file) const {
+	std::fprintf(file, "input: %d presses, key to photon P50 %.1f ms, P99 %.1f ms, max %.1f ms\n", m_count, percentile(0.5f), percentile(0.99f), m_max);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+// One key press: a single Command bit and the Profiler::now() time it arrived.
+struct InputEvent {
+	unsigned command;
+	uint64_t time;
+};
+
+// Hands events from one writer thread to one reader thread in order, without
+// locks. Unlike TripleBuffer nothing is skipped: the reader takes every event,
+// and the writer only loses events once CAPACITY are waiting, counting them.
+class InputQueue {
+
+public:
+	static const unsigned CAPACITY = 256;
+
+private:
+	InputEvent m_events[CAPACITY];
+	std::atomic<unsigned> m_head;
+	std::atomic<unsigned> m_tail;
+	std::atomic<unsigned> m_dropped;
+
+public:
+	InputQueue();
+
+	InputQueue(const InputQueue&) = delete;
+	InputQueue& operator=(const InputQueue&) = delete;
+
+	bool push(const InputEvent& event);
+	bool peek(InputEvent& event) const;
+	void pop();
+
+	unsigned getDropped() const;
+
+};
+
+// Key to photon times in milliseconds: from a press arriving to the end of the
+// first frame that shows the tick applying it. The last HISTORY are kept for
+// the percentiles; every one also lands on the "input" profiler track.
+class InputLatency {
+
+public:
+	static const int HISTORY = 600;
+
+private:
+	std::vector<float> m_times;
+	mutable std::vector<float> m_sorted;
+	int m_next;
+	int m_count;
+	float m_max;
+
+public:
+	InputLatency();
+
+	void add(const InputEvent& event, uint64_t shown);
+	float percentile(float fraction) const;
+	int getCount() const;
+
+	void report(std::FILE* file) const;
+
+};
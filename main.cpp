@@ -1,253 +1,517 @@
-#include "window/window.h"
-#include "graphics/render.h"
-#include "graphics/shader.h"
-#include "entities/light.h"
-#include "graphics/skybox.h"
-#include "entities/camera.h"
-#include "utilities/timer.h"
-#include "maths/random/noise.h"
-#include "graphics/gui/font.h"
-#include "graphics/shadow.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb/stb_image.h"
-
-#include "terrain.h"
-#include "block.h"
-
-int main() {
-	const char* icons[] = {
-		"resources/icon128.png"
-	};
-
-	engine::Window window("T3DRIS");
-	window.setWindowSize(window.getWidth() - 100 * window.getAspectRatio(), window.getHeight() - 100);
-	window.setIcon(icons, 1);
-	window.setMinVersion(3, 3);
-	window.lockCursor();
-	window.enableDepthTest();
-	window.enableTransparancy();
-
-	int n = 0;
-	const GLFWvidmode* vidmode = glfwGetVideoMode(glfwGetMonitors(&n)[0]);
-
-	window.setPosition((vidmode->width - window.getWidth()) / 2, (vidmode->height - window.getHeight()) / 2);
-
-	const int GRID_SIZE = 12;
-	bool ortho = false;
-
-	GLuint nextImage = engine::File::loadTextureID("resources/next.png");
-	engine::Light light(engine::Vector3f(3.0f, 30.0f, -10.0f), engine::Vector4f(1.0f, 1.0f, 1.0f, 1.0f));
-	
-	engine::Shader shadowShader("resources/shadow.vs", "resources/shadow.fs");
-	engine::Shader nextShader("resources/next.vs", "resources/next.fs");
-
-	engine::Font font("resources/font.png", "resources/font.fnt");
-	glBindTexture(GL_TEXTURE_2D, font.getTexture());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	font.enableShader();
-	font.getShader().setUniform3f(font.getShader().getUniformLocation("textColor"), engine::Vector3f(1.0f));
-	font.disableShader();
-
-	engine::Camera camera(engine::Vector3f(0.0f, 0.0f, 0.0f), window.getWidth(), window.getHeight());
-	engine::Entity cameraObject;
-
-	engine::Matrix4f transformation;
-	engine::Matrix4f projection = engine::Matrix4f::perspective(70.0f, window.getAspectRatio(), 0.1f, 200.0f);
-	engine::Matrix4f viewMatrix = engine::Maths::createViewMatrix(camera.getPosition(), camera.getRotation());
-
-	const char* paths[] = {
-		"resources/back.png",
-		"resources/back.png",
-		"resources/back.png",
-		"resources/bottom.png",
-		"resources/back.png",
-		"resources/back.png",
-	};
-
-	engine::Skybox skybox(100.0f, paths);
-	const engine::Model blockModel = engine::Shape3D::cube(0.5f).createModel(true, false);
-
-	Terrain terrain({ float(GRID_SIZE), 21, float(GRID_SIZE) });
-
-	engine::Random random;
-
-	for (int i = 0; i < GRID_SIZE; i++) {
-		for (int j = 0; j < GRID_SIZE; j++) {
-			terrain.set(i, 0, j, new engine::Vector4f(0.5f, 0.8f, 1.0f, 1.0f));
-			for (int k = 0; k < terrain.getSize().y - 1; k++)
-				if (i % (GRID_SIZE - 1) == 0 || j == GRID_SIZE - 1 || (j == 0 && k == 0))
-					terrain.set(i, k, j, &Block::COLORS[int(random.next() * 5)]);
-		}
-	}
-	
-	bool gameOver = false;
-	bool paused = true;
-	int highScore = 0;
-	float fontSize = 0.2f;
-	float speed = 1000;
-	engine::Timer spawnTimer(300);
-	Block* next = new Block(terrain, speed, random.next() * 5);
-	Block* currentBlock = new Block(terrain, speed, random.next() * 5);
-	currentBlock->draw();
-
-	engine::Shadow shadow(2048);
-
-	engine::Matrix4f lightProjection = engine::Matrix4f::ortho(-30.0f, 30.0f, -30.0f, 30.0f, 1.0f, 80.0f);
-	engine::Matrix4f lightView = engine::Matrix4f::lookingAt(light.getPosition(), engine::Vector3f(), engine::Vector3f(0.0f, 1.0f, 0.0f));
-
-	std::string level = "0";
-
-	engine::Timer timer(1000);
-	int frames = 0;
-	int realFrames = 0;
-
-	while (window.isOpen()) {
-
-		if (timer.ready()) {
-			realFrames = frames;
-			window.setTitle(std::string("T3DRIS - FPS: " + std::to_string(frames)).c_str());
-			frames = 0;
-		}
-
-		//update
-		if (window.canUpdate()) {
-			if (!gameOver && !paused) {
-				if (!currentBlock && terrain.isReady()) {
-					if (spawnTimer.ready()) {
-						currentBlock = new Block(terrain, speed, next->getIndex());
-						currentBlock->draw();
-						next = new Block(terrain, speed, random.next() * 5);
-						speed *= 0.985f;
-						level = std::to_string(int(floor(20 - speed / 50)));
-					}
-				}
-
-				if (currentBlock) {
-					if (!currentBlock->update()) {
-						if (currentBlock->gameOver) {
-							gameOver = true;
-							highScore = terrain.getScore();
-						}
-						currentBlock = nullptr;
-					}
-				}
-			}
-
-			if (engine::Input::keyPressed(GLFW_KEY_P))
-				paused = !paused;
-
-			if (gameOver && engine::Input::keyPressed(GLFW_KEY_ENTER)) {
-				for (int i = 1; i < terrain.getSize().x - 1; i++)
-					for (int j = 1; j < terrain.getSize().y - 1; j++)
-						for (int k = 0; k < terrain.getSize().z - 1; k++)
-							terrain.set(i, j, k, nullptr);
-
-				speed = 1000;
-				terrain.addScore(-terrain.getScore());
-				gameOver = false;
-			}
-
-			if (engine::Input::keyPressed(GLFW_KEY_TAB)) {
-				ortho = !ortho;
-				if (ortho)
-					projection = engine::Matrix4f::ortho(-1 * window.getWidth() / 65.0f, 1 * window.getWidth() / 65.0f, -1 * window.getHeight() / 65.0f, 1 * window.getHeight() / 65.0f, 0.1f, 200.0f);
-				else
-					projection = engine::Matrix4f::perspective(70.0f, window.getAspectRatio(), 0.1f, 200.0f);
-			}
-
-			terrain.update();
-
-			camera.focusOnEntity(cameraObject, 0, GRID_SIZE * (1 + !ortho) + terrain.getSize().y * cos(camera.getPitch()) / 3.0f, 0);
-
-			camera.setPitch(camera.getPitch() - engine::Input::mouse_dy / window.getWidth());
-			camera.setPitch(camera.getPitch() < M_PI / 10 ? M_PI / 10 : camera.getPitch() > M_PI / 2 ? M_PI / 2 : camera.getPitch());
-
-			viewMatrix = engine::Maths::createViewMatrix(camera.getPosition(), camera.getRotation());
-
-			window.update();
-
-			//render
-			engine::Render::clear();
-			glViewport(0, 0, shadow.getSize(), shadow.getSize());
-			glBindFramebuffer(GL_FRAMEBUFFER, shadow.getShadowFBO());
-			glClear(GL_DEPTH_BUFFER_BIT);
-
-			terrain.render(&shadowShader, lightProjection, lightView, light, true);
-
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-			engine::Render::clear();
-			glViewport(0, 0, window.getWidth(), window.getHeight());
-			glBindTexture(GL_TEXTURE_2D, shadow.getShadowMap());
-
-			terrain.getShader().enable();
-
-			terrain.getShader().setUniform1f(terrain.getShader().getUniformLocation("shadowMapSize"), shadow.getSize());
-			terrain.getShader().setUniformMatrix4f(terrain.getShader().getUniformLocation("lightProjection"), lightProjection);
-			terrain.getShader().setUniformMatrix4f(terrain.getShader().getUniformLocation("lightView"), lightView);
-
-			terrain.getShader().disable();
-
-			terrain.render(nullptr, projection, viewMatrix, light);
-			skybox.render(projection, camera.getRotation());
-
-			nextShader.enable();
-			nextShader.setUniformMatrix4f(nextShader.getUniformLocation("transformation"), engine::Maths::createTransformationMatrix(
-				engine::Vector3f(-0.925f, -0.2f, 0), engine::Vector3f(-M_PI / 2.0f, 0, 0), engine::Vector3f(0.09f, 0.1f, 0.16f)));
-
-			nextShader.setUniform4f(nextShader.getUniformLocation("blockColor"), Block::COLORS[next->getIndex()]);
-
-			blockModel.bind();
-			engine::Vector3f reference = next->getBlocks()[0];
-			for (const engine::Vector3f& v : next->getBlocks()) {
-				nextShader.setUniform3f(nextShader.getUniformLocation("blockPosition"), v - reference);
-				engine::Render::renderNoBind(blockModel.getIndexLength());
-			}
-
-			blockModel.unbind();
-			nextShader.disable();
-
-			font.enableShader();
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.01f, 0.01f));
-			font.render("TOP", fontSize);
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.01f, font.getTextHeight("TOP", fontSize) + 0.01f));
-			font.render(std::to_string(highScore), fontSize);
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.01f, font.getTextHeight("TOP", fontSize) + font.getTextHeight(std::to_string(terrain.getScore()), fontSize) + 0.05f));
-			font.render("SCORE", fontSize);
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.01f, font.getTextHeight("TOP", fontSize) + font.getTextHeight(std::to_string(terrain.getScore()), fontSize) + font.getTextHeight("SCORE", fontSize) + 0.05f));
-			font.render(std::to_string(terrain.getScore()), fontSize);
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.01f, font.getTextHeight("TOP", fontSize) + font.getTextHeight(std::to_string(terrain.getScore()), fontSize) + font.getTextHeight("SCORE", fontSize) + font.getTextHeight(std::to_string(terrain.getScore()), fontSize) + 0.09f));
-			font.render("NEXT", fontSize);
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.99f - font.getTextWidth("LEVEL", fontSize), 0.01f));
-			font.render("LEVEL", fontSize);
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.99f - font.getTextWidth("LEVEL", fontSize), font.getTextHeight("LEVEL", fontSize) + 0.01f));
-			font.render(level, fontSize);
-
-			font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.99f - font.getTextWidth(ortho ? "ORTHOGRAPHIC" : "PERSPECTIVE", fontSize), 0.99f - font.getTextHeight(ortho ? "ORTHOGRAPHIC" : "PERSPECTIVE", fontSize)));
-			font.render(ortho ? "ORTHOGRAPHIC" : "PERSPECTIVE", fontSize);
-
-			if (gameOver) {
-				font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.5f - font.getTextWidth("GAME OVER", 0.5f) / 2, 0.45f - font.getTextHeight("GAME OVER", 0.5f) / 2));
-				font.render("GAME OVER", 0.5f);
-				font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.5f - font.getTextWidth("PRESS ENTER TO PLAY AGAIN", fontSize) / 2, 0.45f + font.getTextHeight("GAME OVER", 0.5f) / 2));
-				font.render("PRESS ENTER TO PLAY AGAIN", fontSize);
-			}
-			else if (paused) {
-				font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.5f - font.getTextWidth("PAUSED", 0.5f) / 2, 0.45f - font.getTextHeight("PAUSED", 0.5f) / 2));
-				font.render("PAUSED", 0.5f);
-				font.getShader().setUniform2f(font.getShader().getUniformLocation("location"), engine::Vector2f(0.5f - font.getTextWidth("PRESS P TO CONTINUE", fontSize) / 2, 0.45f + font.getTextHeight("PAUSED", 0.5f) / 2));
-				font.render("PRESS P TO CONTINUE", fontSize);
-			}
-
-			font.disableShader();
-
-			frames++;
-
-			window.sync();
-		}
-	}
-
-	return 0;
-}
+#include "window/window.h"
+#include "graphics/render.h"
+#include "graphics/shader.h"
+#include "entities/light.h"
+#include "entities/camera.h"
+#include "utilities/timer.h"
+#include "maths/random/noise.h"
+#include "graphics/gui/font.h"
+#include "graphics/shadow.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+#include "terrain.h"
+#include "block.h"
+#include "simulation.h"
+#include "bot.h"
+#include "simulationthread.h"
+#include "shadowcache.h"
+#include "uniforms.h"
+#include "program.h"
+#include "textlayer.h"
+#include "profiler.h"
+#include "gputimer.h"
+#include "frameoverlay.h"
+#include "allocations.h"
+#include "assetarchive.h"
+#include "assetloader.h"
+#include "sky.h"
+#include "programcache.h"
+#include "framecapture.h"
+
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+
+static engine::Vector4f toVector(const Color& color) {
+	return engine::Vector4f(color.r, color.g, color.b, color.a);
+}
+
+struct KeyCommand {
+	int key;
+	unsigned command;
+};
+
+static const KeyCommand KEY_COMMANDS[] = {
+	{ GLFW_KEY_SPACE, COMMAND_DROP },
+	{ GLFW_KEY_E, COMMAND_ROTATE_Y },
+	{ GLFW_KEY_Q, COMMAND_ROTATE_Z },
+	{ GLFW_KEY_D, COMMAND_LEFT },
+	{ GLFW_KEY_A, COMMAND_RIGHT },
+	{ GLFW_KEY_S, COMMAND_BACK },
+	{ GLFW_KEY_W, COMMAND_FORWARD },
+	{ GLFW_KEY_ENTER, COMMAND_RESTART },
+};
+
+static SimulationThread* s_keyTarget = nullptr;
+static GLFWkeyfun s_engineKeys = nullptr;
+
+// Chained in front of the engine's own callback. Presses are stamped as GLFW
+// delivers them, inside window.update(), and queued for the simulation thread,
+// so a tap shorter than a frame or a tick is neither lost nor merged.
+static void onKey(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	if (s_engineKeys)
+		s_engineKeys(window, key, scancode, action, mods);
+
+	if (action != GLFW_PRESS || !s_keyTarget)
+		return;
+
+	for (const KeyCommand& binding : KEY_COMMANDS)
+		if (binding.key == key)
+			s_keyTarget->post({ binding.command, Profiler::now() });
+}
+
+struct HudState {
+	int highScore;
+	int score;
+	int level;
+	bool ortho;
+	bool gameOver;
+	bool paused;
+
+	bool operator!=(const HudState& state) const {
+		return highScore != state.highScore || score != state.score || level != state.level || ortho != state.ortho || gameOver != state.gameOver || paused != state.paused;
+	}
+};
+
+// The falling piece between the tick before the snapshot and the snapshot
+// itself, by the time passed since it was published. Returns false without one.
+static bool pieceView(const SimulationThread::Snapshot& snapshot, SimulationThread::Clock::time_point now, PieceView& view) {
+	const Block* block = snapshot.simulation.getCurrentBlock();
+	if (!block)
+		return false;
+
+	const float tick = 1.0f / StepTimer::TICKS_PER_SECOND;
+	const float elapsed = std::chrono::duration<float>(now - snapshot.time).count();
+	const float remaining = snapshot.interpolate ? 1.0f - std::min(1.0f, elapsed / tick) : 0.0f;
+	const Point& position = block->getPosition();
+
+	view.cells = block->getBlocks();
+	view.offset[0] = (snapshot.from.x - position.x) * remaining;
+	view.offset[1] = (snapshot.from.y - position.y) * remaining;
+	view.offset[2] = (snapshot.from.z - position.z) * remaining;
+	view.index = block->getIndex();
+	return true;
+}
+
+static void layoutHud(TextLayer& text, engine::Font& font, const HudState& hud, float fontSize) {
+	const std::string highScore = std::to_string(hud.highScore);
+	const std::string score = std::to_string(hud.score);
+	const std::string level = std::to_string(hud.level);
+	const char* mode = hud.ortho ? "ORTHOGRAPHIC" : "PERSPECTIVE";
+
+	const float top = font.getTextHeight("TOP", fontSize);
+	const float scoreHeight = font.getTextHeight(score, fontSize);
+	const float scoreLabel = font.getTextHeight("SCORE", fontSize);
+	const float levelLeft = 0.99f - font.getTextWidth("LEVEL", fontSize);
+
+	text.clear();
+	text.add("TOP", 0.01f, 0.01f, fontSize);
+	text.add(highScore, 0.01f, top + 0.01f, fontSize);
+	text.add("SCORE", 0.01f, top + scoreHeight + 0.05f, fontSize);
+	text.add(score, 0.01f, top + scoreHeight + scoreLabel + 0.05f, fontSize);
+	text.add("NEXT", 0.01f, top + scoreHeight + scoreLabel + scoreHeight + 0.09f, fontSize);
+	text.add("LEVEL", levelLeft, 0.01f, fontSize);
+	text.add(level, levelLeft, font.getTextHeight("LEVEL", fontSize) + 0.01f, fontSize);
+	text.add(mode, 0.99f - font.getTextWidth(mode, fontSize), 0.99f - font.getTextHeight(mode, fontSize), fontSize);
+
+	if (hud.gameOver) {
+		text.add("GAME OVER", 0.5f - font.getTextWidth("GAME OVER", 0.5f) / 2, 0.45f - font.getTextHeight("GAME OVER", 0.5f) / 2, 0.5f);
+		text.add("PRESS ENTER TO PLAY AGAIN", 0.5f - font.getTextWidth("PRESS ENTER TO PLAY AGAIN", fontSize) / 2, 0.45f + font.getTextHeight("GAME OVER", 0.5f) / 2, fontSize);
+	}
+	else if (hud.paused) {
+		text.add("PAUSED", 0.5f - font.getTextWidth("PAUSED", 0.5f) / 2, 0.45f - font.getTextHeight("PAUSED", 0.5f) / 2, 0.5f);
+		text.add("PRESS P TO CONTINUE", 0.5f - font.getTextWidth("PRESS P TO CONTINUE", fontSize) / 2, 0.45f + font.getTextHeight("PAUSED", 0.5f) / 2, fontSize);
+	}
+}
+
+// Usage: T3DRIS [capture <file> [WIDTHxHEIGHT]] [replay file]
+// Every session is recorded to REPLAY_PATH on exit. Given a replay, it is played
+// back instead: P pauses, F fast-forwards to the end without rendering, and the
+// left and right arrows seek ten seconds. F3 shows the frame time overlay, with
+// the key to photon latency of recent presses (see InputLatency), and F12
+// writes the last few seconds of profiler zones to TRACE_PATH.
+// Images packed into ASSET_PATH with the pack tool are mapped from it instead of
+// decoded; without the archive they are read from resources/ as before.
+// The programs this tree links are cached in PROGRAM_CACHE_PATH; deleting it
+// forces a fresh compile.
+// "capture" renders at a fixed size (1280x720 unless given) offscreen and
+// records every frame to file (see FrameCapture); playing a replay, it quits
+// when the replay ends, so it can run unattended under a software GL. Its
+// window stays hidden, but GLFW still needs a display to create the context:
+// on a machine without one, run it under a virtual X server such as Xvfb.
+int main(int argc, char** argv) {
+	const char* REPLAY_PATH = "last.t3dr";
+	const char* TRACE_PATH = "trace.json";
+	const char* ASSET_PATH = "resources/assets.t3da";
+	const char* PROGRAM_CACHE_PATH = "programs.cache";
+	uint64_t launched = Profiler::now();
+
+	const char* capturePath = nullptr;
+	int captureWidth = 1280, captureHeight = 720;
+	if (argc > 2 && std::strcmp(argv[1], "capture") == 0) {
+		capturePath = argv[2];
+		argc -= 2;
+		argv += 2;
+		if (argc > 1 && std::sscanf(argv[1], "%dx%d", &captureWidth, &captureHeight) == 2) {
+			argc--;
+			argv++;
+		}
+	}
+
+	Profiler::setEnabled(true);
+	Profiler::setThreadName("main");
+
+	const char* icons[] = {
+		"resources/icon128.png"
+	};
+
+	// Capture renders offscreen, so its window is never shown, and the cursor and monitor are left alone.
+	if (capturePath) {
+		glfwInit();
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
+	engine::Window window("T3DRIS");
+	window.setWindowSize(window.getWidth() - 100 * window.getAspectRatio(), window.getHeight() - 100);
+	window.setIcon(icons, 1);
+	window.setMinVersion(3, 3);
+	if (!capturePath)
+		window.lockCursor();
+	window.enableDepthTest();
+	window.enableTransparancy();
+
+	int n = 0;
+	GLFWmonitor** monitors = capturePath ? nullptr : glfwGetMonitors(&n);
+	if (n > 0) {
+		const GLFWvidmode* vidmode = glfwGetVideoMode(monitors[0]);
+		window.setPosition((vidmode->width - window.getWidth()) / 2, (vidmode->height - window.getHeight()) / 2);
+	}
+
+	// Show the window cleared right away, then decode the sky on workers while the
+	// shaders are built and the engine loads its font here. Without the archive the
+	// faces are decoded from their files, still only once each.
+	engine::Render::clear();
+	window.sync();
+	// Hidden again in case the engine reset the window hints before creating it.
+	if (capturePath)
+		glfwHideWindow(glfwGetCurrentContext());
+
+	const char* paths[] = {
+		"resources/back.png",
+		"resources/back.png",
+		"resources/back.png",
+		"resources/bottom.png",
+		"resources/back.png",
+		"resources/back.png",
+	};
+
+	ProgramCache programs(PROGRAM_CACHE_PATH);
+	AssetArchive assets;
+	assets.open(ASSET_PATH);
+	AssetLoader loader(assets, 2);
+	Sky sky(programs, loader, paths);
+
+	const int GRID_SIZE = 12;
+
+	engine::Light light(engine::Vector3f(3.0f, 30.0f, -10.0f), engine::Vector4f(1.0f, 1.0f, 1.0f, 1.0f));
+	
+	Program shadowProgram(programs, "resources/shadow.vs", "resources/shadow.fs");
+	Program nextProgram(programs, "resources/next.vs", "resources/next.fs");
+	const Uniforms& nextUniforms = nextProgram.getUniforms();
+
+	engine::Font font("resources/font.png", "resources/font.fnt");
+	glBindTexture(GL_TEXTURE_2D, font.getTexture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	// The font program stays the engine's: engine::Font draws with its own shader and has no way to take a program built here.
+	Uniforms fontUniforms(font.getShader());
+	TextLayer text(programs, font, fontUniforms[UNIFORM_LOCATION]);
+	font.enableShader();
+	font.getShader().setUniform3f(fontUniforms[UNIFORM_TEXT_COLOR], engine::Vector3f(1.0f));
+	font.disableShader();
+
+	GpuTimer gpuTimer;
+	FrameOverlay frameOverlay(programs, font, fontUniforms[UNIFORM_LOCATION], 0.1f);
+
+	std::unique_ptr<FrameCapture> capture;
+	if (capturePath) {
+		capture.reset(new FrameCapture(capturePath, std::max(16, captureWidth), std::max(16, captureHeight)));
+		if (!capture->isOpen()) {
+			std::fprintf(stderr, "cannot write %s\n", capturePath);
+			return 1;
+		}
+	}
+	bool showFrameTimes = false;
+	uint64_t lastFrame = Profiler::now();
+	uint64_t lastAllocations = Allocations::thread().count;
+	AllocationGrowth allocationGrowth(600, stderr);
+
+	engine::Camera camera(engine::Vector3f(0.0f, 0.0f, 0.0f), window.getWidth(), window.getHeight());
+	engine::Entity cameraObject;
+
+	engine::Matrix4f transformation;
+	const float captureAspect = capture ? float(capture->getWidth()) / capture->getHeight() : 0.0f;
+	engine::Matrix4f projection = engine::Matrix4f::perspective(70.0f, capture ? captureAspect : window.getAspectRatio(), 0.1f, 200.0f);
+	engine::Matrix4f viewMatrix = engine::Maths::createViewMatrix(camera.getPosition(), camera.getRotation());
+
+	const engine::Model blockModel = engine::Shape3D::cube(0.5f).createModel(true, false);
+
+	Replay replay;
+	const bool playback = argc > 1 && replay.load(argv[1]);
+	if (!playback)
+		replay = Replay(GRID_SIZE, 21, std::time(nullptr));
+
+	ThreadPool pool;
+	DefaultHeuristic heuristic;
+	Bot bot(pool, heuristic);
+
+	SimulationThread simulationThread(replay, playback, bot, !playback);
+	InputLatency inputLatency;
+	if (!playback) {
+		s_keyTarget = &simulationThread;
+		s_engineKeys = glfwSetKeyCallback(glfwGetCurrentContext(), onKey);
+	}
+
+	// The board as last published, without the falling piece, which is drawn on its own.
+	Grid board(simulationThread.getSnapshot().simulation.getGrid());
+	Terrain terrain(programs, board);
+
+	bool ortho = false;
+	float fontSize = 0.2f;
+	HudState shownHud = { -1, -1, -1, false, false, false };
+
+	engine::Shadow shadow(2048);
+	ShadowCache shadowCache(shadow, terrain, board);
+	programs.report(stderr);
+
+	engine::Matrix4f lightProjection = engine::Matrix4f::ortho(-30.0f, 30.0f, -30.0f, 30.0f, 1.0f, 80.0f);
+	engine::Matrix4f lightView = engine::Matrix4f::lookingAt(light.getPosition(), engine::Vector3f(), engine::Vector3f(0.0f, 1.0f, 0.0f));
+
+	// The light and the preview placement never change, so these are uploaded once.
+	FrameUniforms frameUniforms;
+	const Program& terrainProgram = terrain.getProgram();
+	const Uniforms& terrainUniforms = terrainProgram.getUniforms();
+	if (!terrainUniforms.hasFrameBlock()) {
+		terrainProgram.enable();
+		terrainProgram.setUniform1f(terrainUniforms[UNIFORM_SHADOW_MAP_SIZE], shadow.getSize());
+		terrainProgram.setUniformMatrix4f(terrainUniforms[UNIFORM_LIGHT_PROJECTION], lightProjection);
+		terrainProgram.setUniformMatrix4f(terrainUniforms[UNIFORM_LIGHT_VIEW], lightView);
+		terrainProgram.disable();
+	}
+
+	nextProgram.enable();
+	nextProgram.setUniformMatrix4f(nextUniforms[UNIFORM_TRANSFORMATION], engine::Maths::createTransformationMatrix(
+		engine::Vector3f(-0.925f, -0.2f, 0), engine::Vector3f(-M_PI / 2.0f, 0, 0), engine::Vector3f(0.09f, 0.1f, 0.16f)));
+	nextProgram.disable();
+
+	engine::Timer timer(1000);
+	int frames = 0;
+	unsigned lastTick = 0;
+
+	while (window.isOpen()) {
+		PROFILE_SCOPE("frame");
+
+		const int frameWidth = capture ? capture->getWidth() : window.getWidth();
+		const int frameHeight = capture ? capture->getHeight() : window.getHeight();
+
+		// Allocations are counted on this thread only; the simulation and bot threads have their own zones.
+		const uint64_t frameStart = Profiler::now();
+		const uint64_t allocations = Allocations::thread().count;
+		frameOverlay.add((frameStart - lastFrame) / 1e6f, gpuTimer.getFrameTime(), allocations - lastAllocations);
+		if (Allocations::isTracking())
+			Profiler::counter("allocations", allocations - lastAllocations);
+		allocationGrowth.frame();
+		lastFrame = frameStart;
+		lastAllocations = allocations;
+
+		if (timer.ready()) {
+			const unsigned tick = simulationThread.getSnapshot().tick;
+			window.setTitle(std::string("T3DRIS - FPS: " + std::to_string(frames) + " TPS: " + std::to_string(tick - lastTick)).c_str());
+			frames = 0;
+			lastTick = tick;
+		}
+
+		//input; game keys are queued by onKey during window.update()
+		if (playback) {
+			if (engine::Input::keyPressed(GLFW_KEY_F))
+				simulationThread.fastForward();
+
+			if (engine::Input::keyPressed(GLFW_KEY_LEFT))
+				simulationThread.seek(-int(StepTimer::TICKS_PER_SECOND * 10));
+
+			if (engine::Input::keyPressed(GLFW_KEY_RIGHT))
+				simulationThread.seek(StepTimer::TICKS_PER_SECOND * 10);
+		}
+		else {
+			if (engine::Input::keyPressed(GLFW_KEY_B))
+				simulationThread.toggleAutoplay();
+		}
+
+		if (engine::Input::keyPressed(GLFW_KEY_P))
+			simulationThread.togglePause();
+
+		if (engine::Input::keyPressed(GLFW_KEY_F3))
+			showFrameTimes = !showFrameTimes;
+
+		if (engine::Input::keyPressed(GLFW_KEY_F12))
+			Profiler::capture(TRACE_PATH);
+
+		if (engine::Input::keyPressed(GLFW_KEY_TAB)) {
+			ortho = !ortho;
+			if (ortho)
+				projection = engine::Matrix4f::ortho(-1 * frameWidth / 65.0f, 1 * frameWidth / 65.0f, -1 * frameHeight / 65.0f, 1 * frameHeight / 65.0f, 0.1f, 200.0f);
+			else
+				projection = engine::Matrix4f::perspective(70.0f, capture ? captureAspect : window.getAspectRatio(), 0.1f, 200.0f);
+		}
+
+		camera.focusOnEntity(cameraObject, 0, GRID_SIZE * (1 + !ortho) + terrain.getSize().y * cos(camera.getPitch()) / 3.0f, 0);
+
+		camera.setPitch(camera.getPitch() - engine::Input::mouse_dy / window.getWidth());
+		camera.setPitch(camera.getPitch() < M_PI / 10 ? M_PI / 10 : camera.getPitch() > M_PI / 2 ? M_PI / 2 : camera.getPitch());
+
+		viewMatrix = engine::Maths::createViewMatrix(camera.getPosition(), camera.getRotation());
+
+		window.update();
+
+		//snapshot
+		const bool published = simulationThread.update();
+		const SimulationThread::Snapshot& snapshot = simulationThread.getSnapshot();
+		if (published) {
+			PROFILE_SCOPE("snapshot");
+			board = snapshot.simulation.getGrid();
+			if (const Block* piece = snapshot.simulation.getCurrentBlock())
+				for (const Point& v : piece->getBlocks())
+					board.set(v.x, v.y, v.z, nullptr);
+		}
+
+		const Simulation& simulation = snapshot.simulation;
+		PieceView piece;
+		const bool falling = pieceView(snapshot, SimulationThread::Clock::now(), piece);
+
+		//render
+		frameUniforms.update(projection, viewMatrix, lightProjection, lightView, light, shadow.getSize());
+
+		engine::Render::clear();
+		{
+			PROFILE_SCOPE("shadow");
+			GpuScope gpu(gpuTimer, "shadow");
+			shadowCache.render(shadowProgram, blockModel, falling ? &piece : nullptr, lightProjection, lightView, light);
+		}
+
+		if (capture)
+			capture->begin();
+
+		engine::Render::clear();
+		glViewport(0, 0, frameWidth, frameHeight);
+		glBindTexture(GL_TEXTURE_2D, shadow.getShadowMap());
+
+		{
+			PROFILE_SCOPE("terrain");
+			GpuScope gpu(gpuTimer, "terrain");
+			terrain.render(nullptr, projection, viewMatrix, light);
+			if (falling)
+				terrain.renderPiece(nullptr, blockModel, piece, projection, viewMatrix, light);
+		}
+
+		{
+			PROFILE_SCOPE("skybox");
+			GpuScope gpu(gpuTimer, "skybox");
+			sky.render(projection, viewMatrix);
+		}
+
+		{
+			PROFILE_SCOPE("hud");
+			GpuScope gpu(gpuTimer, "hud");
+
+			nextProgram.enable();
+			nextProgram.setUniform4f(nextUniforms[UNIFORM_BLOCK_COLOR], toVector(Block::COLORS[simulation.getNext().getIndex()]));
+
+			blockModel.bind();
+			const BlockCells nextBlocks = simulation.getNext().getBlocks();
+			const Point reference = nextBlocks[0];
+			for (const Point& v : nextBlocks) {
+				nextProgram.setUniform3f(nextUniforms[UNIFORM_BLOCK_POSITION], float(v.x - reference.x), float(v.y - reference.y), float(v.z - reference.z));
+				engine::Render::renderNoBind(blockModel.getIndexLength());
+			}
+
+			blockModel.unbind();
+			nextProgram.disable();
+
+			const HudState hud = { simulation.getHighScore(), simulation.getGrid().getScore(), simulation.getLevel(), ortho, simulation.isGameOver(), snapshot.paused };
+			if (hud != shownHud) {
+				layoutHud(text, font, hud, fontSize);
+				shownHud = hud;
+			}
+
+			text.render(frameWidth, frameHeight);
+			if (showFrameTimes)
+				frameOverlay.render(frameWidth, frameHeight);
+		}
+
+		if (capture) {
+			PROFILE_SCOPE("capture");
+			capture->end(window.getWidth(), window.getHeight());
+		}
+
+		gpuTimer.frame();
+		frames++;
+
+		{
+			PROFILE_SCOPE("sync");
+			window.sync();
+		}
+
+		// Presses first shown by this frame end here, once it is swapped.
+		InputEvent shown;
+		const uint64_t swapped = Profiler::now();
+		bool pressed = false;
+		while (simulationThread.takeShown(shown)) {
+			inputLatency.add(shown, swapped);
+			pressed = true;
+		}
+		if (pressed)
+			frameOverlay.setInputLatency(inputLatency.percentile(0.5f));
+
+		if (launched) {
+			Profiler::record("startup", "first frame", launched, Profiler::now());
+			launched = 0;
+		}
+
+		if (capture && snapshot.finished)
+			break;
+	}
+
+	if (capture) {
+		capture->finish();
+		capture->report(stderr);
+	}
+
+	if (!playback) {
+		glfwSetKeyCallback(glfwGetCurrentContext(), s_engineKeys);
+		s_keyTarget = nullptr;
+		inputLatency.report(stderr);
+	}
+
+	simulationThread.stop();
+	if (Allocations::isTracking())
+		Allocations::report(stderr);
+
+	if (!playback)
+		replay.save(REPLAY_PATH);
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_mapping(nullptr) {
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const char* path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	m_mapping = mapping;
+	m_size = size_t(size.QuadPart);
+#else
+	const int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	void* data = fstat(file, &status) == 0 && status.st_size > 0 ? mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	::close(file);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const unsigned char*>(data);
+	m_size = size_t(status.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (m_data) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+#else
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+}
+
+bool MappedFile::isOpen() const {
+	return m_data != nullptr;
+}
+
+const unsigned char* MappedFile::getData() const {
+	return m_data;
+}
+
+size_t MappedFile::getSize() const {
+	return m_size;
+}
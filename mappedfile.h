@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// A whole file mapped read-only into memory. Empty and missing files fail to open.
+class MappedFile {
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	void* m_mapping;
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const;
+	const unsigned char* getData() const;
+	size_t getSize() const;
+
+};
@@ -0,0 +1,348 @@
+#include "mesher.h"
+
+static bool occupied(const Grid& grid, int x, int y, int z) {
+	const Point& size = grid.getSize();
+	if (x < 0 || y < 0 || z < 0 || x >= size.x || y >= size.y || z >= size.z)
+		return false;
+
+	return grid.isSolid(x, y, z);
+}
+
+Mesher::Mesher() : m_chunkCount({ 0, 0, 0 }), m_batches(MAX_COLORS), m_colorCount(0), m_vertexCount(0), m_garbage(0), m_generation(0) {
+}
+
+uint64_t Mesher::layerHash(const Grid& grid, int cx, int y, int cz) {
+	if (y < 0 || y >= grid.getSize().y)
+		return 0;
+
+	const Grid::Chunk* chunk = grid.getChunk(cx, y >> Grid::CHUNK_BITS, cz);
+	return chunk ? chunk->layerHashes[y & (Grid::CHUNK_SIZE - 1)] : 0;
+}
+
+// The live vertices of a patch, all colors together.
+int Mesher::patchVertices(const Patch& patch) {
+	int count = 0;
+	for (int c = 0; c < MAX_COLORS; c++)
+		count += patch.counts[c];
+	return count;
+}
+
+// Like Grid's palette, colors past MAX_COLORS share the last index.
+unsigned char Mesher::colorIndex(const Color* color) {
+	for (int i = 0; i < m_colorCount; i++)
+		if (m_colors[i] == color)
+			return (unsigned char) i;
+
+	if (m_colorCount < MAX_COLORS) {
+		m_colors[m_colorCount] = color;
+		m_batches[m_colorCount].color = color;
+		return (unsigned char) m_colorCount++;
+	}
+
+	return MAX_COLORS - 1;
+}
+
+// Appends one rectangle as two triangles to m_faces, and its color to m_faceColors.
+void Mesher::emit(int axis, int direction, float plane, float u0, float u1, float v0, float v1, const Color* color) {
+	// u and v are the two axes following the normal axis, so u x v points along +axis.
+	const int u = (axis + 1) % 3;
+	const int v = (axis + 2) % 3;
+	const float corners[4][2] = { { u0, v0 }, { u1, v0 }, { u1, v1 }, { u0, v1 } };
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+
+	for (int i = 0; i < 6; i++) {
+		const float* corner = corners[direction > 0 ? order[i] : order[5 - i]];
+		float position[3];
+		position[axis] = plane;
+		position[u] = corner[0];
+		position[v] = corner[1];
+
+		m_faces.push_back(position[0]);
+		m_faces.push_back(position[1]);
+		m_faces.push_back(position[2]);
+		m_faces.push_back(axis == 0 ? float(direction) : 0.0f);
+		m_faces.push_back(axis == 1 ? float(direction) : 0.0f);
+		m_faces.push_back(axis == 2 ? float(direction) : 0.0f);
+	}
+
+	m_faceColors.push_back(colorIndex(color));
+}
+
+void Mesher::meshTop(const Grid& grid, const Point& start, const Point& end, int direction) {
+	const Point& size = grid.getSize();
+	const float offsetX = size.x / 2.0f + 0.5f;
+	const float offsetY = size.y / 2.0f;
+	const float offsetZ = size.z / 2.0f + 0.5f;
+	const int width = end.x - start.x;
+	const int depth = end.z - start.z;
+	const int y = start.y;
+
+	for (int k = 0; k < depth; k++) {
+		for (int i = 0; i < width; i++) {
+			const int x = start.x + i;
+			const int z = start.z + k;
+			m_mask[k * width + i] = occupied(grid, x, y + direction, z) ? nullptr : grid.get(x, y, z);
+		}
+	}
+
+	for (int k = 0; k < depth; k++) {
+		for (int i = 0; i < width; ) {
+			const Color* color = m_mask[k * width + i];
+			if (!color) {
+				i++;
+				continue;
+			}
+
+			int w = 1;
+			while (i + w < width && m_mask[k * width + i + w] == color)
+				w++;
+
+			int d = 1;
+			for (bool full = true; full && k + d < depth; ) {
+				for (int l = 0; l < w; l++) {
+					if (m_mask[(k + d) * width + i + l] != color) {
+						full = false;
+						break;
+					}
+				}
+				if (full)
+					d++;
+			}
+
+			for (int a = 0; a < d; a++)
+				for (int l = 0; l < w; l++)
+					m_mask[(k + a) * width + i + l] = nullptr;
+
+			const float x0 = start.x + i - offsetX;
+			const float z0 = start.z + k - offsetZ;
+			emit(1, direction, y - offsetY + direction * 0.5f, z0, z0 + d, x0, x0 + w, color);
+			i += w;
+		}
+	}
+}
+
+void Mesher::meshSide(const Grid& grid, const Point& start, const Point& end, int axis, int direction) {
+	const Point& size = grid.getSize();
+	const float offsets[3] = { size.x / 2.0f, size.y / 2.0f, size.z / 2.0f };
+	const int y = start.y;
+
+	// Faces normal to X run along Z and faces normal to Z run along X; runs stay inside the patch.
+	const int planeStart = axis == 0 ? start.x : start.z;
+	const int planeEnd = axis == 0 ? end.x : end.z;
+	const int runStart = axis == 0 ? start.z : start.x;
+	const int runEnd = axis == 0 ? end.z : end.x;
+	const int dx = axis == 0 ? direction : 0;
+	const int dz = axis == 2 ? direction : 0;
+
+	for (int p = planeStart; p < planeEnd; p++) {
+		for (int r = runStart; r < runEnd; ) {
+			const int x = axis == 0 ? p : r;
+			const int z = axis == 0 ? r : p;
+			const Color* color = grid.get(x, y, z);
+
+			if (!color || occupied(grid, x + dx, y, z + dz)) {
+				r++;
+				continue;
+			}
+
+			int run = 1;
+			while (r + run < runEnd) {
+				const int nx = axis == 0 ? p : r + run;
+				const int nz = axis == 0 ? r + run : p;
+				if (grid.get(nx, y, nz) != color || occupied(grid, nx + dx, y, nz + dz))
+					break;
+				run++;
+			}
+
+			const float plane = p - offsets[axis] + direction * 0.5f;
+			const float first = r - offsets[axis == 0 ? 2 : 0] - 0.5f;
+			const float bottom = y - offsets[1] - 0.5f;
+
+			if (axis == 0) // u = y, v = z
+				emit(0, direction, plane, bottom, bottom + 1.0f, first, first + run, color);
+			else // u = x, v = y
+				emit(2, direction, plane, first, first + run, bottom, bottom + 1.0f, color);
+
+			r += run;
+		}
+	}
+}
+
+// Meshes the patch into m_faces, then writes its faces sorted by color into its
+// range, moving the range to the end of the array if it no longer fits.
+void Mesher::meshPatch(const Grid& grid, int cx, int y, int cz, Patch& patch) {
+	const Point& size = grid.getSize();
+	const Point start = { cx << Grid::CHUNK_BITS, y, cz << Grid::CHUNK_BITS };
+	const Point end = { std::min(start.x + Grid::CHUNK_SIZE, size.x), y + 1, std::min(start.z + Grid::CHUNK_SIZE, size.z) };
+
+	m_faces.clear();
+	m_faceColors.clear();
+
+	meshTop(grid, start, end, 1);
+	meshTop(grid, start, end, -1);
+	meshSide(grid, start, end, 0, 1);
+	meshSide(grid, start, end, 0, -1);
+	meshSide(grid, start, end, 2, 1);
+	meshSide(grid, start, end, 2, -1);
+
+	const int count = int(m_faceColors.size()) * 6;
+	m_vertexCount += count - patchVertices(patch);
+
+	if (count > patch.capacity) {
+		m_garbage += patch.capacity;
+		patch.first = int(m_vertices.size() / VERTEX_FLOATS);
+		patch.capacity = count + count / 2;
+		m_vertices.resize(m_vertices.size() + size_t(patch.capacity) * VERTEX_FLOATS);
+	}
+
+	int offsets[MAX_COLORS];
+	std::fill(patch.counts, patch.counts + MAX_COLORS, 0);
+	for (unsigned char color : m_faceColors)
+		patch.counts[color] += 6;
+
+	for (int c = 0, offset = patch.first; c < MAX_COLORS; c++) {
+		offsets[c] = offset;
+		offset += patch.counts[c];
+	}
+
+	const size_t faceFloats = 6 * VERTEX_FLOATS;
+	for (size_t f = 0; f < m_faceColors.size(); f++) {
+		int& offset = offsets[m_faceColors[f]];
+		std::copy(m_faces.begin() + f * faceFloats, m_faces.begin() + (f + 1) * faceFloats, m_vertices.begin() + size_t(offset) * VERTEX_FLOATS);
+		offset += 6;
+	}
+}
+
+void Mesher::release(Patch& patch) {
+	m_vertexCount -= patchVertices(patch);
+	m_garbage += patch.capacity;
+	patch.live = false;
+	patch.capacity = 0;
+	std::fill(patch.counts, patch.counts + MAX_COLORS, 0);
+}
+
+// Packs the live ranges to the front, keeping their spare room.
+void Mesher::compact() {
+	m_compacted.clear();
+	for (Patch& patch : m_patches) {
+		if (!patch.live)
+			continue;
+
+		const int first = int(m_compacted.size() / VERTEX_FLOATS);
+		m_compacted.insert(m_compacted.end(), m_vertices.begin() + size_t(patch.first) * VERTEX_FLOATS,
+			m_vertices.begin() + size_t(patch.first + patch.capacity) * VERTEX_FLOATS);
+		patch.first = first;
+	}
+
+	m_vertices.swap(m_compacted);
+	m_garbage = 0;
+}
+
+void Mesher::updateBatches() {
+	for (Batch& batch : m_batches) {
+		batch.firsts.clear();
+		batch.counts.clear();
+	}
+
+	for (const Patch& patch : m_patches) {
+		if (!patch.live)
+			continue;
+
+		for (int c = 0, first = patch.first; c < m_colorCount; c++) {
+			if (patch.counts[c]) {
+				m_batches[c].firsts.push_back(first);
+				m_batches[c].counts.push_back(patch.counts[c]);
+			}
+			first += patch.counts[c];
+		}
+	}
+}
+
+bool Mesher::update(const Grid& grid) {
+	const Point& chunks = grid.getChunkCount();
+	bool changed = false;
+
+	if (chunks.x != m_chunkCount.x || chunks.y != m_chunkCount.y || chunks.z != m_chunkCount.z) {
+		clear();
+		m_chunkCount = chunks;
+		m_patches.assign(size_t(chunks.y) * Grid::CHUNK_SIZE * chunks.z * chunks.x, Patch());
+		changed = true;
+	}
+
+	m_generation++;
+
+	for (int cy = 0; cy < chunks.y; cy++) {
+		for (int cz = 0; cz < chunks.z; cz++) {
+			for (int cx = 0; cx < chunks.x; cx++) {
+				const Grid::Chunk* chunk = grid.getChunk(cx, cy, cz);
+				if (!chunk)
+					continue;
+
+				for (int l = 0; l < Grid::CHUNK_SIZE; l++) {
+					if (!chunk->layerCounts[l])
+						continue;
+
+					const int y = (cy << Grid::CHUNK_BITS) + l;
+					uint64_t key = chunk->layerHashes[l];
+					const uint64_t neighbours[6] = {
+						layerHash(grid, cx, y - 1, cz), layerHash(grid, cx, y + 1, cz),
+						layerHash(grid, cx - 1, y, cz), layerHash(grid, cx + 1, y, cz),
+						layerHash(grid, cx, y, cz - 1), layerHash(grid, cx, y, cz + 1)
+					};
+					for (int i = 0; i < 6; i++)
+						key = (key ^ neighbours[i]) * 0x100000001B3ull + i;
+
+					Patch& patch = m_patches[(y * chunks.z + cz) * chunks.x + cx];
+					patch.generation = m_generation;
+					if (patch.live && patch.key == key)
+						continue;
+
+					patch.live = true;
+					patch.key = key;
+					meshPatch(grid, cx, y, cz, patch);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	for (Patch& patch : m_patches) {
+		if (patch.live && patch.generation != m_generation) {
+			release(patch);
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		if (m_garbage > m_vertexCount)
+			compact();
+		updateBatches();
+	}
+
+	return changed;
+}
+
+// Forgets every patch, so the next update() meshes the whole grid again into
+// the storage already allocated.
+void Mesher::clear() {
+	for (Patch& patch : m_patches)
+		release(patch);
+
+	m_vertices.clear();
+	m_vertexCount = 0;
+	m_garbage = 0;
+	m_colorCount = 0;
+	updateBatches();
+}
+
+const std::vector<float>& Mesher::getVertices() const {
+	return m_vertices;
+}
+
+const std::vector<Mesher::Batch>& Mesher::getBatches() const {
+	return m_batches;
+}
+
+int Mesher::getVertexCount() const {
+	return m_vertexCount;
+}
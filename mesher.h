@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "grid.h"
+
+// Builds a triangle mesh of only the exposed cell faces of a Grid, merging
+// same colored coplanar faces into rectangles. The grid is meshed in patches of
+// one Y layer by one chunk column (16x16 cells), and only patches of non-empty
+// chunks are visited. A patch is rebuilt when its layer hash or that of one of
+// the six neighbouring patches it touches changed.
+// Vertices are position and normal, centered like Terrain's cells. Every patch
+// owns a range of one persistent vertex array, sorted by color, and is rewritten
+// in place while it fits; a patch that outgrows its range moves to the end, and
+// the ranges left behind are compacted once they outweigh the live vertices.
+// getBatches() lists the ranges of each color, so the mesh is drawn with one
+// call per color and the color set as a uniform.
+class Mesher {
+
+public:
+	static const int VERTEX_FLOATS = 6;
+	static const int MAX_COLORS = Grid::PALETTE_SIZE;
+
+	// The vertex ranges of one color, in the form glMultiDrawArrays takes.
+	struct Batch {
+		const Color* color;
+		std::vector<int> firsts;
+		std::vector<int> counts;
+	};
+
+private:
+	struct Patch {
+		uint64_t key;
+		bool live;
+		unsigned generation;
+		int first;
+		int capacity;
+		int counts[MAX_COLORS];
+	};
+
+	std::vector<Patch> m_patches;
+	Point m_chunkCount;
+	std::vector<float> m_vertices;
+	std::vector<float> m_compacted;
+	std::vector<float> m_faces;
+	std::vector<unsigned char> m_faceColors;
+	std::vector<Batch> m_batches;
+	const Color* m_colors[MAX_COLORS];
+	int m_colorCount;
+	int m_vertexCount;
+	int m_garbage;
+	const Color* m_mask[Grid::CHUNK_SIZE * Grid::CHUNK_SIZE];
+	unsigned m_generation;
+
+	static uint64_t layerHash(const Grid& grid, int cx, int y, int cz);
+	static int patchVertices(const Patch& patch);
+	unsigned char colorIndex(const Color* color);
+	void meshPatch(const Grid& grid, int cx, int y, int cz, Patch& patch);
+	void meshTop(const Grid& grid, const Point& start, const Point& end, int direction);
+	void meshSide(const Grid& grid, const Point& start, const Point& end, int axis, int direction);
+	void emit(int axis, int direction, float plane, float u0, float u1, float v0, float v1, const Color* color);
+	void release(Patch& patch);
+	void compact();
+	void updateBatches();
+
+public:
+	Mesher();
+
+	bool update(const Grid& grid);
+	void clear();
+
+	const std::vector<float>& getVertices() const;
+	const std::vector<Batch>& getBatches() const;
+	int getVertexCount() const;
+
+};
@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+#include "assetarchive.h"
+
+// Packs game files into an archive the game maps at startup instead of
+// decoding them. Names are stored as given, so run it from the game directory:
+// Usage: pack resources/assets.t3da resources/*.png resources/*.vs resources/*.fs resources/font.fnt
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: pack <archive> <file>...\n");
+		return 1;
+	}
+
+	const std::vector<std::string> files(argv + 2, argv + argc);
+	if (!AssetArchive::pack(argv[1], files)) {
+		std::fprintf(stderr, "could not pack %s\n", argv[1]);
+		return 1;
+	}
+
+	AssetArchive archive;
+	if (!archive.open(argv[1])) {
+		std::fprintf(stderr, "could not read back %s\n", argv[1]);
+		return 1;
+	}
+
+	std::printf("packed %d files into %s\n", int(files.size()), argv[1]);
+	return 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// Compile-time shape tables for every piece in all 24 orientations of the cube.
+// Offsets are relative to the piece's pivot cell, which rotations keep in place.
+// Orientation 0 is the spawn orientation; ROTATE_Y (key E) and ROTATE_Z (key Q)
+// map an orientation to the one reached by a quarter turn around that axis.
+namespace pieces {
+
+	static const int TYPES = 5;
+	static const int ORIENTATIONS = 24;
+	static const int MAX_CELLS = 8;
+
+	struct Offset {
+		signed char x, y, z;
+	};
+
+	struct Matrix {
+		signed char m[3][3];
+	};
+
+	struct Tables {
+		Offset cells[TYPES][ORIENTATIONS][MAX_CELLS];
+		unsigned char rotateY[ORIENTATIONS];
+		unsigned char rotateZ[ORIENTATIONS];
+	};
+
+	constexpr int CELL_COUNTS[TYPES] = { 8, 4, 4, 4, 4 };
+
+	constexpr Offset BASE[TYPES][MAX_CELLS] = {
+		{ { 0, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 }, { 0, -1, 1 }, { 1, 0, 0 }, { 1, 0, 1 }, { 1, -1, 0 }, { 1, -1, 1 } }, // Cube
+		{ { -2, 0, 0 }, { -1, 0, 0 }, { 0, 0, 0 }, { 1, 0, 0 } }, // I
+		{ { 0, 0, 0 }, { 1, 0, 0 }, { 2, 0, 0 }, { 0, 0, 1 } }, // L
+		{ { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, 0 }, { 1, 0, 1 } }, // S
+		{ { -1, 0, 0 }, { 0, 0, 0 }, { 1, 0, 0 }, { 0, 0, 1 } } // T
+	};
+
+	// Pivot position relative to the spawn corner (size.x / 2 - 1, size.y - 2, size.z / 2 - 1).
+	constexpr Offset SPAWN[TYPES] = { { 0, 0, 0 }, { 2, 0, 0 }, { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 } };
+
+	// (x, y, z) -> (z, y, -x) and (x, y, z) -> (y, -x, z), the turns Block applied for E and Q.
+	constexpr Matrix TURN_Y = { { { 0, 0, 1 }, { 0, 1, 0 }, { -1, 0, 0 } } };
+	constexpr Matrix TURN_Z = { { { 0, 1, 0 }, { -1, 0, 0 }, { 0, 0, 1 } } };
+
+	constexpr Matrix multiply(const Matrix& a, const Matrix& b) {
+		Matrix result = {};
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				for (int k = 0; k < 3; k++)
+					result.m[i][j] += a.m[i][k] * b.m[k][j];
+		return result;
+	}
+
+	constexpr bool equal(const Matrix& a, const Matrix& b) {
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				if (a.m[i][j] != b.m[i][j])
+					return false;
+		return true;
+	}
+
+	constexpr int find(const Matrix* matrices, int count, const Matrix& matrix) {
+		for (int i = 0; i < count; i++)
+			if (equal(matrices[i], matrix))
+				return i;
+		return -1;
+	}
+
+	constexpr Offset apply(const Matrix& matrix, const Offset& offset) {
+		Offset result = {};
+		result.x = (signed char) (matrix.m[0][0] * offset.x + matrix.m[0][1] * offset.y + matrix.m[0][2] * offset.z);
+		result.y = (signed char) (matrix.m[1][0] * offset.x + matrix.m[1][1] * offset.y + matrix.m[1][2] * offset.z);
+		result.z = (signed char) (matrix.m[2][0] * offset.x + matrix.m[2][1] * offset.y + matrix.m[2][2] * offset.z);
+		return result;
+	}
+
+	constexpr Tables build() {
+		Tables tables = {};
+		Matrix matrices[ORIENTATIONS] = {};
+		matrices[0] = { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } };
+		int count = 1;
+
+		// Breadth first over the two quarter turns reaches all 24 rotations.
+		for (int i = 0; i < count; i++) {
+			const Matrix turned[2] = { multiply(TURN_Y, matrices[i]), multiply(TURN_Z, matrices[i]) };
+			for (int t = 0; t < 2; t++) {
+				int index = find(matrices, count, turned[t]);
+				if (index < 0) {
+					index = count;
+					matrices[count++] = turned[t];
+				}
+				if (t == 0)
+					tables.rotateY[i] = (unsigned char) index;
+				else
+					tables.rotateZ[i] = (unsigned char) index;
+			}
+		}
+
+		for (int type = 0; type < TYPES; type++)
+			for (int o = 0; o < ORIENTATIONS; o++)
+				for (int c = 0; c < CELL_COUNTS[type]; c++)
+					tables.cells[type][o][c] = apply(matrices[o], BASE[type][c]);
+
+		return tables;
+	}
+
+	constexpr Tables TABLES = build();
+
+	static_assert(TABLES.rotateY[TABLES.rotateY[TABLES.rotateY[TABLES.rotateY[0]]]] == 0, "four Y turns must return to the spawn orientation");
+	static_assert(TABLES.rotateZ[TABLES.rotateZ[TABLES.rotateZ[TABLES.rotateZ[0]]]] == 0, "four Z turns must return to the spawn orientation");
+
+}
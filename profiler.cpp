@@ -0,0 +1,175 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+std::atomic<bool> Profiler::s_enabled(false);
+std::mutex Profiler::s_mutex;
+std::vector<Profiler::Ring*> Profiler::s_rings;
+
+// Rings are never freed: a thread that exits leaves its zones to be captured,
+// and the game only ever starts a handful of threads.
+Profiler::Ring* Profiler::createRing(const char* name) {
+	Ring* ring = new Ring();
+	ring->head = 0;
+	ring->name = name;
+	ring->depth = 0;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	ring->id = int(s_rings.size()) + 1;
+	s_rings.push_back(ring);
+	return ring;
+}
+
+Profiler::Ring& Profiler::threadRing() {
+	thread_local Ring* ring = createRing(nullptr);
+	return *ring;
+}
+
+// Only the owning thread pushes; the head is released after the slot is written
+// so capture() never reads a slot newer than the head it saw.
+void Profiler::push(Ring& ring, const char* name, uint64_t begin, uint64_t end, int depth) {
+	const uint64_t head = ring.head.load(std::memory_order_relaxed);
+	Event& event = ring.events[head % RING_SIZE];
+	event.name.store(name, std::memory_order_relaxed);
+	event.begin.store(begin, std::memory_order_relaxed);
+	event.end.store(end, std::memory_order_relaxed);
+	event.depth.store(depth, std::memory_order_relaxed);
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::setEnabled(bool enabled) {
+	s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::isEnabled() {
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const char* name) {
+	threadRing().name = name;
+}
+
+// Nanoseconds on the steady clock.
+uint64_t Profiler::now() {
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+int Profiler::enter() {
+	return threadRing().depth++;
+}
+
+void Profiler::leave(const char* name, uint64_t begin, int depth) {
+	const uint64_t end = now();
+	Ring& ring = threadRing();
+	ring.depth = depth;
+	push(ring, name, begin, end, depth);
+}
+
+// Pseudo threads are looked up by name under the lock; they are meant for
+// results that arrive a few per frame, each track fed by a single thread.
+void Profiler::record(const char* track, const char* name, uint64_t begin, uint64_t end) {
+	if (!isEnabled())
+		return;
+
+	Ring* ring = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (Ring* candidate : s_rings)
+			if (candidate->name.load() && !strcmp(candidate->name.load(), track))
+				ring = candidate;
+	}
+
+	if (!ring)
+		ring = createRing(track);
+
+	push(*ring, name, begin, end, 0);
+}
+
+// Counters are kept as events with a negative depth and the value as their end.
+void Profiler::counter(const char* name, uint64_t value) {
+	if (isEnabled())
+		push(threadRing(), name, now(), value, -1);
+}
+
+static void writeString(FILE* file, const char* text) {
+	fputc('"', file);
+	for (const char* c = text ? text : "?"; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*c >= 0x20)
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool Profiler::capture(const char* path) {
+	struct Captured {
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+		int depth;
+	};
+
+	std::vector<Ring*> rings;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		rings = s_rings;
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	uint64_t origin = ~0ull;
+	std::vector<std::vector<Captured>> captured(rings.size());
+
+	for (size_t i = 0; i < rings.size(); i++) {
+		Ring& ring = *rings[i];
+		const uint64_t head = ring.head.load(std::memory_order_acquire);
+		const uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+
+		for (uint64_t index = first; index < head; index++) {
+			const Event& event = ring.events[index % RING_SIZE];
+			captured[i].push_back({ event.name.load(std::memory_order_relaxed), event.begin.load(std::memory_order_relaxed),
+				event.end.load(std::memory_order_relaxed), event.depth.load(std::memory_order_relaxed) });
+		}
+
+		// Drop whatever the owning thread overwrote while it was being copied.
+		const uint64_t overwritten = ring.head.load(std::memory_order_acquire) - first;
+		const uint64_t drop = overwritten > RING_SIZE ? std::min<uint64_t>(overwritten - RING_SIZE, captured[i].size()) : 0;
+		captured[i].erase(captured[i].begin(), captured[i].begin() + drop);
+
+		for (const Captured& event : captured[i])
+			origin = std::min(origin, event.begin);
+	}
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+
+	for (size_t i = 0; i < rings.size(); i++) {
+		fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", i ? ",\n" : "", rings[i]->id);
+		const char* name = rings[i]->name.load();
+		writeString(file, name ? name : ("thread " + std::to_string(rings[i]->id)).c_str());
+		fputs("}}", file);
+
+		for (const Captured& event : captured[i]) {
+			if (event.depth < 0) {
+				fprintf(file, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"name\":", rings[i]->id, (event.begin - origin) / 1000.0);
+				writeString(file, event.name);
+				fprintf(file, ",\"args\":{\"value\":%llu}}", (unsigned long long)event.end);
+				continue;
+			}
+
+			fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", rings[i]->id,
+				(event.begin - origin) / 1000.0, (event.end - event.begin) / 1000.0);
+			writeString(file, event.name);
+			fprintf(file, ",\"args\":{\"depth\":%d}}", event.depth);
+		}
+	}
+
+	fputs("\n]}\n", file);
+	return fclose(file) == 0;
+}
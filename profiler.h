@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+#include "allocations.h"
+
+// Records named, nestable time zones per thread into fixed rings that only
+// their own thread writes, so recording takes no lock. Nothing is recorded
+// until setEnabled(true), which leaves a scope costing one relaxed load.
+// capture() writes what the rings still hold as Chrome trace event JSON
+// (chrome://tracing or ui.perfetto.dev). Zones measured elsewhere, such as GPU
+// timer queries, are added with record() on a named pseudo thread, and
+// per-frame values such as allocation counts with counter().
+class Profiler {
+
+public:
+	static const int RING_SIZE = 1 << 15;
+
+private:
+	struct Event {
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> begin;
+		std::atomic<uint64_t> end;
+		std::atomic<int> depth;
+	};
+
+	struct Ring {
+		Event events[RING_SIZE];
+		std::atomic<uint64_t> head;
+		std::atomic<const char*> name;
+		int id;
+		int depth;
+	};
+
+	static std::atomic<bool> s_enabled;
+	static std::mutex s_mutex;
+	static std::vector<Ring*> s_rings;
+
+	static Ring* createRing(const char* name);
+	static Ring& threadRing();
+	static void push(Ring& ring, const char* name, uint64_t begin, uint64_t end, int depth);
+
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+	static void setThreadName(const char* name);
+
+	static uint64_t now();
+	static int enter();
+	static void leave(const char* name, uint64_t begin, int depth);
+	static void record(const char* track, const char* name, uint64_t begin, uint64_t end);
+	static void counter(const char* name, uint64_t value);
+
+	static bool capture(const char* path);
+
+};
+
+class ProfileScope {
+
+private:
+	const char* m_name;
+	uint64_t m_begin;
+	int m_depth;
+#ifdef T3DRIS_TRACK_ALLOCATIONS
+	const char* m_site;
+#endif
+
+public:
+	// Allocation tracking builds charge allocations to the zone even while the profiler is off.
+	ProfileScope(const char* name) : m_name(name), m_begin(0), m_depth(-1) {
+#ifdef T3DRIS_TRACK_ALLOCATIONS
+		m_site = Allocations::enterSite(name);
+#endif
+		if (Profiler::isEnabled()) {
+			m_depth = Profiler::enter();
+			m_begin = Profiler::now();
+		}
+	}
+
+	~ProfileScope() {
+		if (m_depth >= 0)
+			Profiler::leave(m_name, m_begin, m_depth);
+#ifdef T3DRIS_TRACK_ALLOCATIONS
+		Allocations::leaveSite(m_site);
+#endif
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
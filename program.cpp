@@ -0,0 +1,42 @@
+#include "program.h"
+
+Program::Program(ProgramCache& programs, const char* vertexPath, const char* fragmentPath) : m_program(programs.buildFiles(vertexPath, fragmentPath)), 
+	m_uniforms(m_program) {
+}
+
+Program::~Program() {
+	glDeleteProgram(m_program);
+}
+
+void Program::enable() const {
+	glUseProgram(m_program);
+}
+
+void Program::disable() const {
+	glUseProgram(0);
+}
+
+void Program::setUniform1f(GLint location, float value) const {
+	glUniform1f(location, value);
+}
+
+void Program::setUniform3f(GLint location, const engine::Vector3f& value) const {
+	glUniform3f(location, value.x, value.y, value.z);
+}
+
+void Program::setUniform3f(GLint location, float x, float y, float z) const {
+	glUniform3f(location, x, y, z);
+}
+
+void Program::setUniform4f(GLint location, const engine::Vector4f& value) const {
+	glUniform4f(location, value.x, value.y, value.z, value.w);
+}
+
+// Matrix4f is column major, as FrameUniforms uploads it too.
+void Program::setUniformMatrix4f(GLint location, const engine::Matrix4f& value) const {
+	glUniformMatrix4fv(location, 1, GL_FALSE, reinterpret_cast<const GLfloat*>(&value));
+}
+
+const Uniforms& Program::getUniforms() const {
+	return m_uniforms;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "maths/maths.h"
+#include "graphics/render.h"
+
+#include "uniforms.h"
+#include "programcache.h"
+
+// A shader program read from its resource files and built through the
+// ProgramCache, with the uniform setters engine::Shader offers. The Uniforms of
+// the program are looked up once it is linked.
+class Program {
+
+private:
+	GLuint m_program;
+	Uniforms m_uniforms;
+
+public:
+	Program(ProgramCache& programs, const char* vertexPath, const char* fragmentPath);
+	~Program();
+
+	Program(const Program&) = delete;
+	Program& operator=(const Program&) = delete;
+
+	void enable() const;
+	void disable() const;
+
+	void setUniform1f(GLint location, float value) const;
+	void setUniform3f(GLint location, const engine::Vector3f& value) const;
+	void setUniform3f(GLint location, float x, float y, float z) const;
+	void setUniform4f(GLint location, const engine::Vector4f& value) const;
+	void setUniformMatrix4f(GLint location, const engine::Matrix4f& value) const;
+
+	const Uniforms& getUniforms() const;
+
+};
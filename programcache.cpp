@@ -0,0 +1,210 @@
+#include "programcache.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include "profiler.h"
+
+static const char MAGIC[4] = { 'T', '3', 'D', 'P' };
+
+// FNV-1a, continued from a previous hash so several strings chain into one key.
+static uint64_t hash(const char* text, uint64_t value = 14695981039346656037ull) {
+	for (const char* c = text; *c; c++)
+		value = (value ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+	return (value ^ 0xFF) * 1099511628211ull;
+}
+
+static const char* getString(GLenum name) {
+	const GLubyte* value = glGetString(name);
+	return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+static bool readFile(const char* path, std::string& text) {
+	std::FILE* file = std::fopen(path, "rb");
+	if (!file)
+		return false;
+
+	char buffer[4096];
+	for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+		text.append(buffer, read);
+	std::fclose(file);
+	return true;
+}
+
+static GLuint compileShader(GLenum type, const char* source, const char* name) {
+	const GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE, length = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		std::vector<GLchar> log(size_t(std::max(length, 1)), 0);
+		glGetShaderInfoLog(shader, GLsizei(log.size()), nullptr, log.data());
+		std::fprintf(stderr, "%s: %s shader failed to compile:\n%s\n", name, type == GL_VERTEX_SHADER ? "vertex" : "fragment", log.data());
+	}
+
+	return shader;
+}
+
+template <class T>
+static bool readValue(const std::vector<unsigned char>& data, size_t& offset, T& value) {
+	if (data.size() - offset < sizeof(T))
+		return false;
+
+	std::memcpy(&value, data.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+template <class T>
+static void writeValue(std::vector<unsigned char>& data, T value) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+	data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+// Needs the GL context: the driver strings are part of every key.
+ProgramCache::ProgramCache(const char* path) : m_path(path), m_supported(false), m_dirty(false), m_hits(0), m_compiles(0), m_hitTime(0), m_compileTime(0) {
+	m_driver = std::string(getString(GL_VENDOR)) + "\n" + getString(GL_RENDERER) + "\n" + getString(GL_VERSION);
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	m_supported = formats > 0;
+
+	if (m_supported)
+		load();
+}
+
+ProgramCache::~ProgramCache() {
+	if (m_dirty)
+		save();
+}
+
+// A file that is unreadable or cut short is ignored from the first bad entry on.
+void ProgramCache::load() {
+	std::vector<unsigned char> data;
+	if (std::FILE* file = std::fopen(m_path.c_str(), "rb")) {
+		unsigned char buffer[4096];
+		for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+			data.insert(data.end(), buffer, buffer + read);
+		std::fclose(file);
+	}
+
+	size_t offset = sizeof(MAGIC);
+	uint32_t version = 0;
+	if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0 || !readValue(data, offset, version) || version != VERSION)
+		return;
+
+	uint64_t key;
+	uint32_t format, size;
+	while (readValue(data, offset, key) && readValue(data, offset, format) && readValue(data, offset, size) && size <= data.size() - offset) {
+		Binary& binary = m_binaries[key];
+		binary.format = format;
+		binary.data.assign(data.begin() + offset, data.begin() + offset + size);
+		offset += size;
+	}
+}
+
+void ProgramCache::save() const {
+	std::vector<unsigned char> data(MAGIC, MAGIC + sizeof(MAGIC));
+	writeValue(data, VERSION);
+	for (const auto& entry : m_binaries) {
+		writeValue(data, entry.first);
+		writeValue(data, uint32_t(entry.second.format));
+		writeValue(data, uint32_t(entry.second.data.size()));
+		data.insert(data.end(), entry.second.data.begin(), entry.second.data.end());
+	}
+
+	std::FILE* file = std::fopen(m_path.c_str(), "wb");
+	if (!file)
+		return;
+
+	std::fwrite(data.data(), 1, data.size(), file);
+	std::fclose(file);
+}
+
+GLuint ProgramCache::compile(uint64_t key, const char* vertexSource, const char* fragmentSource, const char* name) {
+	const GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource, name);
+	const GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource, name);
+	const GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	if (m_supported)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	GLint linked = GL_FALSE, length = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::vector<GLchar> log(size_t(std::max(length, 1)), 0);
+		glGetProgramInfoLog(program, GLsizei(log.size()), nullptr, log.data());
+		std::fprintf(stderr, "%s: program failed to link:\n%s\n", name, log.data());
+		length = 0;
+	}
+
+	if (m_supported && linked)
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length > 0) {
+		Binary& binary = m_binaries[key];
+		binary.data.resize(size_t(length));
+		glGetProgramBinary(program, length, &length, &binary.format, binary.data.data());
+		binary.data.resize(size_t(length));
+		m_dirty = true;
+	}
+
+	return program;
+}
+
+GLuint ProgramCache::build(const char* vertexSource, const char* fragmentSource, const char* name) {
+	const uint64_t key = hash(m_driver.c_str(), hash(fragmentSource, hash(vertexSource)));
+	const uint64_t begin = Profiler::now();
+
+	const auto cached = m_binaries.find(key);
+	if (cached != m_binaries.end()) {
+		const GLuint program = glCreateProgram();
+		glProgramBinary(program, cached->second.format, cached->second.data.data(), GLsizei(cached->second.data.size()));
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (linked) {
+			const uint64_t end = Profiler::now();
+			Profiler::record("startup", "program cached", begin, end);
+			m_hitTime += (end - begin) * 1e-6;
+			m_hits++;
+			return program;
+		}
+
+		// Rejected after a driver update the strings did not reveal: compile and store it again.
+		glDeleteProgram(program);
+		m_binaries.erase(cached);
+		m_dirty = true;
+	}
+
+	const GLuint program = compile(key, vertexSource, fragmentSource, name);
+	const uint64_t end = Profiler::now();
+	Profiler::record("startup", "program compiled", begin, end);
+	m_compileTime += (end - begin) * 1e-6;
+	m_compiles++;
+	return program;
+}
+
+// A missing file is reported and compiles as empty source, which then fails to compile and says so too.
+GLuint ProgramCache::buildFiles(const char* vertexPath, const char* fragmentPath) {
+	std::string vertexSource, fragmentSource;
+	if (!readFile(vertexPath, vertexSource))
+		std::fprintf(stderr, "cannot read %s\n", vertexPath);
+	if (!readFile(fragmentPath, fragmentSource))
+		std::fprintf(stderr, "cannot read %s\n", fragmentPath);
+
+	const std::string name = std::string(vertexPath) + " + " + fragmentPath;
+	return build(vertexSource.c_str(), fragmentSource.c_str(), name.c_str());
+}
+
+void ProgramCache::report(std::FILE* file) const {
+	std::fprintf(file, "programs: %d cached in %.2f ms, %d compiled in %.2f ms\n", m_hits, m_hitTime, m_compiles, m_compileTime);
+}
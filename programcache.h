@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "graphics/render.h"
+
+// Links the shader programs this tree builds, from inline sources or from the
+// resource files, and keeps their driver binaries in one file so later launches
+// skip the compile. Compile and link failures are logged to stderr.
+// Binaries are keyed by a hash of both sources and the GL vendor, renderer and
+// version strings; one that is missing or that the driver rejects is compiled
+// again and replaces the stored one. The file is rewritten on destruction when
+// anything changed. Every build lands on the "startup" profiler track.
+// Layout: "T3DP", VERSION, then per program its key, binary format, size and
+// bytes, in native byte order: the file never leaves the machine it was made on.
+class ProgramCache {
+
+public:
+	static const uint32_t VERSION = 1;
+
+private:
+	struct Binary {
+		GLenum format;
+		std::vector<unsigned char> data;
+	};
+
+	std::string m_path;
+	std::string m_driver;
+	std::unordered_map<uint64_t, Binary> m_binaries;
+	bool m_supported;
+	bool m_dirty;
+	int m_hits;
+	int m_compiles;
+	double m_hitTime;
+	double m_compileTime;
+
+	void load();
+	void save() const;
+	GLuint compile(uint64_t key, const char* vertexSource, const char* fragmentSource, const char* name);
+
+public:
+	ProgramCache(const char* path);
+	~ProgramCache();
+
+	ProgramCache(const ProgramCache&) = delete;
+	ProgramCache& operator=(const ProgramCache&) = delete;
+
+	GLuint build(const char* vertexSource, const char* fragmentSource, const char* name = "inline program");
+	GLuint buildFiles(const char* vertexPath, const char* fragmentPath);
+	void report(std::FILE* file) const;
+
+};
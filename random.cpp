@@ -0,0 +1,24 @@
+#include "random.h"
+
+Random::Random(uint64_t seed) : m_state(seed ? seed : 0x9E3779B97F4A7C15ull) {
+}
+
+uint64_t Random::nextInt() {
+	m_state ^= m_state >> 12;
+	m_state ^= m_state << 25;
+	m_state ^= m_state >> 27;
+	return m_state * 0x2545F4914F6CDD1Dull;
+}
+
+float Random::next() {
+	return (nextInt() >> 40) / float(1 << 24);
+}
+
+uint64_t Random::getState() const {
+	return m_state;
+}
+
+// The state is never zero, where xorshift would stay.
+void Random::setState(uint64_t state) {
+	m_state = state ? state : 0x9E3779B97F4A7C15ull;
+}
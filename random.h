@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+class Random {
+
+private:
+	uint64_t m_state;
+
+public:
+	Random(uint64_t seed);
+
+	float next();
+	uint64_t nextInt();
+
+	uint64_t getState() const;
+	void setState(uint64_t state);
+
+};
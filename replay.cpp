@@ -0,0 +1,179 @@
+#include "replay.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const char MAGIC[4] = { 'T', '3', 'D', 'R' };
+
+static void writeVarint(std::vector<unsigned char>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back((unsigned char)value);
+}
+
+static bool readVarint(const std::vector<unsigned char>& in, size_t& offset, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && offset < in.size(); shift += 7) {
+		const unsigned char byte = in[offset++];
+		value |= uint64_t(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+Replay::Replay() : m_seed(0), m_size(0), m_height(0), m_ticks(0), m_lastEvent(0) {
+}
+
+Replay::Replay(int size, int height, uint64_t seed) : m_seed(seed), m_size(size), m_height(height), m_ticks(0), m_lastEvent(0) {
+}
+
+void Replay::write(uint32_t value) {
+	writeVarint(m_stream, value);
+}
+
+bool Replay::read(size_t& offset, uint32_t& value) const {
+	uint64_t wide;
+	if (!readVarint(m_stream, offset, wide) || wide > UINT32_MAX)
+		return false;
+
+	value = uint32_t(wide);
+	return true;
+}
+
+void Replay::record(unsigned commands) {
+	if (commands) {
+		write(m_ticks - m_lastEvent);
+		write(commands);
+		m_lastEvent = m_ticks;
+	}
+
+	m_ticks++;
+}
+
+bool Replay::save(const char* path) const {
+	std::vector<unsigned char> header(MAGIC, MAGIC + sizeof(MAGIC));
+	writeVarint(header, VERSION);
+	for (int i = 0; i < 8; i++)
+		header.push_back((unsigned char)(m_seed >> (8 * i)));
+	writeVarint(header, m_size);
+	writeVarint(header, m_height);
+	writeVarint(header, m_ticks);
+	writeVarint(header, m_stream.size());
+
+	std::FILE* file = std::fopen(path, "wb");
+	if (!file)
+		return false;
+
+	bool written = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+	written = written && std::fwrite(m_stream.data(), 1, m_stream.size(), file) == m_stream.size();
+	return std::fclose(file) == 0 && written;
+}
+
+bool Replay::load(const char* path) {
+	std::FILE* file = std::fopen(path, "rb");
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> data;
+	unsigned char buffer[4096];
+	for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+		data.insert(data.end(), buffer, buffer + read);
+	std::fclose(file);
+
+	if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+		return false;
+
+	size_t offset = sizeof(MAGIC);
+	uint64_t version, size, height, ticks, length;
+	if (!readVarint(data, offset, version) || version != VERSION || data.size() - offset < 8)
+		return false;
+
+	uint64_t seed = 0;
+	for (int i = 0; i < 8; i++)
+		seed |= uint64_t(data[offset++]) << (8 * i);
+
+	if (!readVarint(data, offset, size) || !readVarint(data, offset, height) || !readVarint(data, offset, ticks) || !readVarint(data, offset, length))
+		return false;
+
+	if (size < 3 || size > 1024 || height < 3 || height > 1024 || ticks > UINT32_MAX || length != data.size() - offset)
+		return false;
+
+	std::vector<unsigned char> stream(data.begin() + offset, data.end());
+
+	// Events must decode, move forward and stay inside the recorded ticks.
+	uint64_t tick = 0;
+	for (size_t position = 0, events = 0; position < stream.size(); events++) {
+		uint64_t delta, commands;
+		if (!readVarint(stream, position, delta) || !readVarint(stream, position, commands) || commands > UINT32_MAX)
+			return false;
+
+		if ((events > 0 && delta == 0) || (tick += delta) >= ticks)
+			return false;
+	}
+
+	m_seed = seed;
+	m_size = int(size);
+	m_height = int(height);
+	m_ticks = unsigned(ticks);
+	m_lastEvent = unsigned(tick);
+	m_stream.swap(stream);
+	return true;
+}
+
+Replay::Cursor Replay::begin() const {
+	Cursor cursor = { 0, 0, 0 };
+	uint32_t delta, commands;
+	if (read(cursor.offset, delta) && read(cursor.offset, commands)) {
+		cursor.tick = delta;
+		cursor.commands = commands;
+	}
+	else {
+		cursor.offset = 0;
+		cursor.tick = UINT32_MAX;
+	}
+
+	return cursor;
+}
+
+// Returns the commands of tick and moves the cursor past it. Ticks must be asked for in order.
+unsigned Replay::commandsAt(Cursor& cursor, unsigned tick) const {
+	if (tick != cursor.tick)
+		return 0;
+
+	const unsigned commands = cursor.commands;
+	uint32_t delta, next;
+	if (read(cursor.offset, delta) && read(cursor.offset, next) && delta > 0) {
+		cursor.tick += delta;
+		cursor.commands = next;
+	}
+	else {
+		cursor.tick = UINT32_MAX;
+	}
+
+	return commands;
+}
+
+uint64_t Replay::getSeed() const {
+	return m_seed;
+}
+
+int Replay::getSize() const {
+	return m_size;
+}
+
+int Replay::getHeight() const {
+	return m_height;
+}
+
+unsigned Replay::getTicks() const {
+	return m_ticks;
+}
+
+size_t Replay::getStreamSize() const {
+	return m_stream.size();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A recorded session: the simulation parameters and the commands of every tick.
+// Ticks without input are not stored; the stream is a sequence of varint pairs
+// (ticks since the previous event, command bits). Files start with "T3DR" and a
+// format version, then the seed (8 bytes, little endian) and varints for the
+// size, height, tick count and stream length.
+class Replay {
+
+public:
+	static const uint32_t VERSION = 1;
+
+	// Position in the stream: the next event happens at tick with commands.
+	struct Cursor {
+		size_t offset;
+		unsigned tick;
+		unsigned commands;
+	};
+
+private:
+	std::vector<unsigned char> m_stream;
+	uint64_t m_seed;
+	int m_size;
+	int m_height;
+	unsigned m_ticks;
+	unsigned m_lastEvent;
+
+	void write(uint32_t value);
+	bool read(size_t& offset, uint32_t& value) const;
+
+public:
+	Replay();
+	Replay(int size, int height, uint64_t seed);
+
+	void record(unsigned commands);
+
+	bool save(const char* path) const;
+	bool load(const char* path);
+
+	Cursor begin() const;
+	unsigned commandsAt(Cursor& cursor, unsigned tick) const;
+
+	uint64_t getSeed() const;
+	int getSize() const;
+	int getHeight() const;
+	unsigned getTicks() const;
+	size_t getStreamSize() const;
+
+};
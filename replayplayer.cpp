@@ -0,0 +1,58 @@
+#include "replayplayer.h"
+
+#include <algorithm>
+
+ReplayPlayer::ReplayPlayer(const Replay& replay) : m_replay(replay), m_simulation(replay.getSize(), replay.getHeight(), replay.getSeed()),
+	m_cursor(replay.begin()), m_tick(0) {
+
+	m_keyframes.push_back({ m_tick, m_cursor, m_simulation });
+}
+
+// Advances one tick with the recorded commands. Returns false once the recording is over.
+bool ReplayPlayer::step() {
+	if (isFinished())
+		return false;
+
+	m_simulation.update(m_replay.commandsAt(m_cursor, m_tick));
+	m_tick++;
+
+	if (m_tick % KEYFRAME_INTERVAL == 0 && m_tick / KEYFRAME_INTERVAL == m_keyframes.size())
+		m_keyframes.push_back({ m_tick, m_cursor, m_simulation });
+
+	return true;
+}
+
+// Runs up to ticks ticks as fast as possible and returns how many were run.
+unsigned ReplayPlayer::fastForward(unsigned ticks) {
+	unsigned count = 0;
+	while (count < ticks && step())
+		count++;
+
+	return count;
+}
+
+void ReplayPlayer::seek(unsigned tick) {
+	tick = std::min(tick, m_replay.getTicks());
+
+	const Keyframe& keyframe = m_keyframes[std::min<size_t>(tick / KEYFRAME_INTERVAL, m_keyframes.size() - 1)];
+	if (tick < m_tick || keyframe.tick > m_tick) {
+		m_simulation = keyframe.simulation;
+		m_cursor = keyframe.cursor;
+		m_tick = keyframe.tick;
+	}
+
+	while (m_tick < tick)
+		step();
+}
+
+const Simulation& ReplayPlayer::getSimulation() const {
+	return m_simulation;
+}
+
+unsigned ReplayPlayer::getTick() const {
+	return m_tick;
+}
+
+bool ReplayPlayer::isFinished() const {
+	return m_tick >= m_replay.getTicks();
+}
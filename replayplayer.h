@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include "replay.h"
+#include "simulation.h"
+
+// Plays a Replay back on its own Simulation. A keyframe (a copy of the
+// simulation, which shares grid chunks until either side writes) is kept every
+// KEYFRAME_INTERVAL ticks the first time playback passes it, so seeking goes to
+// the nearest keyframe at or before the target and simulates only the rest.
+class ReplayPlayer {
+
+private:
+	struct Keyframe {
+		unsigned tick;
+		Replay::Cursor cursor;
+		Simulation simulation;
+	};
+
+	const Replay& m_replay;
+	Simulation m_simulation;
+	std::vector<Keyframe> m_keyframes;
+	Replay::Cursor m_cursor;
+	unsigned m_tick;
+
+public:
+	static const unsigned KEYFRAME_INTERVAL = StepTimer::TICKS_PER_SECOND * 10;
+
+	ReplayPlayer(const Replay& replay);
+
+	ReplayPlayer(const ReplayPlayer&) = delete;
+	ReplayPlayer& operator=(const ReplayPlayer&) = delete;
+
+	bool step();
+	unsigned fastForward(unsigned ticks);
+	void seek(unsigned tick);
+
+	const Simulation& getSimulation() const;
+	unsigned getTick() const;
+	bool isFinished() const;
+
+};
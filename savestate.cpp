@@ -0,0 +1,81 @@
+#include "savestate.h"
+
+#include <cstring>
+
+StateWriter::StateWriter(std::vector<unsigned char>& data) : m_data(data) {
+}
+
+void StateWriter::write(uint64_t value) {
+	while (value >= 0x80) {
+		m_data.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+
+	m_data.push_back((unsigned char)value);
+}
+
+void StateWriter::writeSigned(int64_t value) {
+	write((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+void StateWriter::writeFloat(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	write(bits);
+}
+
+void StateWriter::writeBytes(const void* bytes, size_t size) {
+	const unsigned char* begin = static_cast<const unsigned char*>(bytes);
+	m_data.insert(m_data.end(), begin, begin + size);
+}
+
+StateReader::StateReader(const unsigned char* data, size_t size) : m_data(data), m_size(size), m_offset(0), m_valid(true) {
+}
+
+uint64_t StateReader::read() {
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64 && m_offset < m_size; shift += 7) {
+		const unsigned char byte = m_data[m_offset++];
+		value |= uint64_t(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+
+	m_valid = false;
+	return 0;
+}
+
+int64_t StateReader::readSigned() {
+	const uint64_t value = read();
+	return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+float StateReader::readFloat() {
+	const uint64_t bits = read();
+	if (bits > UINT32_MAX)
+		m_valid = false;
+
+	const uint32_t word = uint32_t(bits);
+	float value;
+	std::memcpy(&value, &word, sizeof(value));
+	return value;
+}
+
+// Consumes size bytes if they equal expected, such as a file's magic.
+bool StateReader::readBytes(const void* expected, size_t size) {
+	if (!m_valid || m_size - m_offset < size || std::memcmp(m_data + m_offset, expected, size) != 0) {
+		m_valid = false;
+		return false;
+	}
+
+	m_offset += size;
+	return true;
+}
+
+void StateReader::fail() {
+	m_valid = false;
+}
+
+bool StateReader::isValid() const {
+	return m_valid;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Encoding of saved game states. Values are varints (signed ones zigzag
+// encoded, floats by their bits), so a state is compact without a schema and
+// reads the same on any byte order. StateReader works on any memory, a mapped
+// file included, and turns invalid once a value runs past the end: a caller
+// reads everything, then checks isValid() once.
+class StateWriter {
+
+private:
+	std::vector<unsigned char>& m_data;
+
+public:
+	StateWriter(std::vector<unsigned char>& data);
+
+	void write(uint64_t value);
+	void writeSigned(int64_t value);
+	void writeFloat(float value);
+	void writeBytes(const void* bytes, size_t size);
+
+};
+
+class StateReader {
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_offset;
+	bool m_valid;
+
+public:
+	StateReader(const unsigned char* data, size_t size);
+
+	uint64_t read();
+	int64_t readSigned();
+	float readFloat();
+	bool readBytes(const void* expected, size_t size);
+	void fail();
+
+	bool isValid() const;
+
+};
@@ -0,0 +1,86 @@
+#include "shadowcache.h"
+
+#include <cstring>
+
+ShadowCache::ShadowCache(engine::Shadow& shadow, Terrain& terrain, const Grid& board) : m_shadow(shadow), m_terrain(terrain), m_board(board),
+	m_staticFramebuffer(0), m_staticDepth(0), m_staticHash(0), m_pieceKey(0), m_valid(false) {
+
+	// Blitting depth needs both attachments in the same format, so copy the shadow map's.
+	GLint format = GL_DEPTH_COMPONENT24;
+	glBindTexture(GL_TEXTURE_2D, m_shadow.getShadowMap());
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+	glGenTextures(1, &m_staticDepth);
+	glBindTexture(GL_TEXTURE_2D, m_staticDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, m_shadow.getSize(), m_shadow.getSize(), 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &m_staticFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_staticFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_staticDepth, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowCache::~ShadowCache() {
+	glDeleteFramebuffers(1, &m_staticFramebuffer);
+	glDeleteTextures(1, &m_staticDepth);
+}
+
+uint64_t ShadowCache::pieceKey(const PieceView* piece) {
+	if (!piece)
+		return 0;
+
+	uint64_t key = 0xCBF29CE484222325ull ^ piece->index;
+	for (const Point& v : piece->cells)
+		key = (key ^ uint64_t(v.x | v.y << 10 | v.z << 20)) * 0x100000001B3ull;
+
+	for (float offset : piece->offset) {
+		uint32_t bits;
+		std::memcpy(&bits, &offset, sizeof(bits));
+		key = (key ^ bits) * 0x100000001B3ull;
+	}
+
+	return key | 1;
+}
+
+// Brings the shadow map up to date with the board and piece. Returns false when it already was.
+bool ShadowCache::render(const Program& program, const engine::Model& blockModel, const PieceView* piece, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light) {
+	const uint64_t key = pieceKey(piece);
+	if (m_valid && m_staticHash == m_board.getHash() && m_pieceKey == key)
+		return false;
+
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+	const int size = m_shadow.getSize();
+	glViewport(0, 0, size, size);
+
+	if (!m_valid || m_staticHash != m_board.getHash()) {
+		glBindFramebuffer(GL_FRAMEBUFFER, m_staticFramebuffer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		m_terrain.render(&program, projection, view, light, true);
+		m_staticHash = m_board.getHash();
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_staticFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_shadow.getShadowFBO());
+	glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_shadow.getShadowFBO());
+	if (piece)
+		m_terrain.renderPiece(&program, blockModel, *piece, projection, view, light, true);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+	m_pieceKey = key;
+	m_valid = true;
+	return true;
+}
+
+void ShadowCache::invalidate() {
+	m_valid = false;
+}
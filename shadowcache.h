@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "maths/maths.h"
+#include "graphics/shadow.h"
+#include "graphics/render.h"
+#include "entities/light.h"
+
+#include "grid.h"
+#include "block.h"
+#include "terrain.h"
+#include "program.h"
+
+// Keeps the shadow map from being redrawn while nothing moved. The settled
+// board (the grid without the falling piece, meshed by the given terrain) is
+// drawn into a static depth layer only when its hash changes; the shadow map is
+// then that layer copied over plus the cubes of the piece, and is left alone
+// while neither changes, so paused and idle frames skip the shadow pass.
+class ShadowCache {
+
+private:
+	engine::Shadow& m_shadow;
+	Terrain& m_terrain;
+	const Grid& m_board;
+	GLuint m_staticFramebuffer;
+	GLuint m_staticDepth;
+	uint64_t m_staticHash;
+	uint64_t m_pieceKey;
+	bool m_valid;
+
+	static uint64_t pieceKey(const PieceView* piece);
+
+public:
+	ShadowCache(engine::Shadow& shadow, Terrain& terrain, const Grid& board);
+	~ShadowCache();
+
+	ShadowCache(const ShadowCache&) = delete;
+	ShadowCache& operator=(const ShadowCache&) = delete;
+
+	bool render(const Program& program, const engine::Model& blockModel, const PieceView* piece, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light);
+	void invalidate();
+
+};
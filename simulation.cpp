@@ -0,0 +1,221 @@
+#include "simulation.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "mappedfile.h"
+
+const Color Simulation::FLOOR_COLOR = { 0.5f, 0.8f, 1.0f, 1.0f };
+
+static const char MAGIC[4] = { 'T', '3', 'D', 'S' };
+
+// Every color a grid may hold, by its id in saved states. New colors go last.
+static const Color* const STATE_COLORS[] = {
+	&Grid::REMOVE_COLOR,
+	&Simulation::FLOOR_COLOR,
+	&Block::COLORS[0],
+	&Block::COLORS[1],
+	&Block::COLORS[2],
+	&Block::COLORS[3],
+	&Block::COLORS[4]
+};
+
+static const int STATE_COLOR_COUNT = sizeof(STATE_COLORS) / sizeof(STATE_COLORS[0]);
+
+Simulation::Simulation(int size, int height, uint64_t seed) : m_grid({ size, height, size }), m_random(seed), m_spawnTimer(StepTimer::milliseconds(300)), 
+	m_currentBlock(m_grid, 0, 0), m_next(m_grid, 0, 0), m_falling(true), m_speed(1000), m_gameOver(false), m_highScore(0), m_spawnCount(1) {
+
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			m_grid.set(i, 0, j, &FLOOR_COLOR);
+			for (int k = 0; k < height - 1; k++)
+				if (i % (size - 1) == 0 || j == size - 1 || (j == 0 && k == 0))
+					m_grid.set(i, k, j, &Block::COLORS[nextIndex()]);
+		}
+	}
+
+	m_next = Block(m_grid, StepTimer::milliseconds(m_speed), nextIndex());
+	m_currentBlock = Block(m_grid, StepTimer::milliseconds(m_speed), nextIndex());
+	m_currentBlock.draw();
+}
+
+Simulation::Simulation(const Simulation& simulation) : m_grid(simulation.m_grid), m_random(simulation.m_random), m_spawnTimer(simulation.m_spawnTimer), 
+	m_currentBlock(m_grid, simulation.m_currentBlock), m_next(m_grid, simulation.m_next), m_falling(simulation.m_falling), 
+	m_speed(simulation.m_speed), m_gameOver(simulation.m_gameOver), m_highScore(simulation.m_highScore), m_spawnCount(simulation.m_spawnCount) {
+}
+
+Simulation& Simulation::operator=(const Simulation& simulation) {
+	if (this == &simulation)
+		return *this;
+
+	m_grid = simulation.m_grid;
+	m_random = simulation.m_random;
+	m_spawnTimer = simulation.m_spawnTimer;
+	m_currentBlock = simulation.m_currentBlock;
+	m_next = simulation.m_next;
+	m_falling = simulation.m_falling;
+
+	m_speed = simulation.m_speed;
+	m_gameOver = simulation.m_gameOver;
+	m_highScore = simulation.m_highScore;
+	m_spawnCount = simulation.m_spawnCount;
+	return *this;
+}
+
+// See Grid::reclaim.
+void Simulation::reclaim(Simulation& stale) {
+	m_grid.reclaim(stale.m_grid);
+}
+
+unsigned Simulation::nextIndex() {
+	return unsigned(m_random.next() * 5);
+}
+
+void Simulation::update(unsigned commands) {
+	if (m_gameOver && (commands & COMMAND_RESTART))
+		restart();
+
+	m_grid.tick();
+
+	if (!m_gameOver) {
+		if (!m_falling && m_grid.isReady()) {
+			if (m_spawnTimer.ready(m_grid.getTime())) {
+				m_currentBlock = Block(m_grid, StepTimer::milliseconds(m_speed), m_next.getIndex());
+				m_currentBlock.draw();
+				m_falling = true;
+				m_spawnCount++;
+				m_next = Block(m_grid, StepTimer::milliseconds(m_speed), nextIndex());
+				m_speed *= 0.985f;
+			}
+		}
+
+		if (m_falling) {
+			if (!m_currentBlock.update(commands)) {
+				if (m_currentBlock.gameOver) {
+					m_gameOver = true;
+					m_highScore = m_grid.getScore();
+				}
+				m_falling = false;
+			}
+		}
+	}
+
+	m_grid.update();
+}
+
+void Simulation::restart() {
+	m_grid.clear();
+
+	m_falling = false;
+
+	m_speed = 1000;
+	m_grid.addScore(-m_grid.getScore());
+	m_gameOver = false;
+}
+
+// Replaces data, so a reused buffer stops allocating once it is large enough.
+void Simulation::save(std::vector<unsigned char>& data) const {
+	data.clear();
+	StateWriter writer(data);
+	writer.writeBytes(MAGIC, sizeof(MAGIC));
+	writer.write(STATE_VERSION);
+
+	writer.write(m_spawnTimer.getDelay());
+	writer.write(m_spawnTimer.getLast());
+	writer.write(m_falling | m_gameOver << 1);
+	writer.writeFloat(m_speed);
+	writer.writeSigned(m_highScore);
+	writer.write(m_spawnCount);
+	writer.write(m_random.getState());
+
+	// The grid only holds the colors above, so saving it cannot fail.
+	m_grid.save(writer, STATE_COLORS, STATE_COLOR_COUNT);
+	m_currentBlock.save(writer);
+	m_next.save(writer);
+}
+
+// Leaves the simulation untouched if the state is invalid or from another version.
+bool Simulation::restore(const unsigned char* data, size_t size) {
+	StateReader reader(data, size);
+	reader.readBytes(MAGIC, sizeof(MAGIC));
+	if (reader.read() != STATE_VERSION)
+		return false;
+
+	const uint64_t spawnDelay = reader.read();
+	const uint64_t spawnLast = reader.read();
+	const uint64_t flags = reader.read();
+	const float speed = reader.readFloat();
+	const int64_t highScore = reader.readSigned();
+	const uint64_t spawnCount = reader.read();
+	const uint64_t state = reader.read();
+	if (!reader.isValid() || spawnDelay > UINT32_MAX || spawnLast > UINT32_MAX || flags > 3 || !(speed > 0) || highScore < INT32_MIN || highScore > INT32_MAX ||
+		spawnCount > UINT32_MAX || state == 0)
+		return false;
+
+	// The pieces are checked against the grid they will sit on.
+	Grid grid({ 1, 1, 1 });
+	if (!grid.restore(reader, STATE_COLORS, STATE_COLOR_COUNT))
+		return false;
+
+	Block current(grid, 0, 0);
+	Block next(grid, 0, 0);
+	if (!current.restore(reader) || !next.restore(reader))
+		return false;
+
+	m_grid = grid;
+	m_random.setState(state);
+	m_spawnTimer = StepTimer(unsigned(spawnDelay), unsigned(spawnLast));
+	m_currentBlock = current;
+	m_next = next;
+	m_falling = flags & 1;
+	m_speed = speed;
+	m_gameOver = (flags & 2) != 0;
+	m_highScore = int(highScore);
+	m_spawnCount = unsigned(spawnCount);
+	return true;
+}
+
+bool Simulation::save(const char* path) const {
+	std::vector<unsigned char> data;
+	save(data);
+
+	std::FILE* file = std::fopen(path, "wb");
+	if (!file)
+		return false;
+
+	const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	return std::fclose(file) == 0 && written;
+}
+
+bool Simulation::load(const char* path) {
+	MappedFile file;
+	return file.open(path) && restore(file.getData(), file.getSize());
+}
+
+const Grid& Simulation::getGrid() const {
+	return m_grid;
+}
+
+const Block* Simulation::getCurrentBlock() const {
+	return m_falling ? &m_currentBlock : nullptr;
+}
+
+const Block& Simulation::getNext() const {
+	return m_next;
+}
+
+bool Simulation::isGameOver() const {
+	return m_gameOver;
+}
+
+int Simulation::getHighScore() const {
+	return m_highScore;
+}
+
+int Simulation::getLevel() const {
+	return int(std::floor(20 - m_speed / 50));
+}
+
+unsigned Simulation::getSpawnCount() const {
+	return m_spawnCount;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "grid.h"
+#include "block.h"
+#include "random.h"
+#include "steptimer.h"
+
+// The game rules. Copies are cheap, sharing the grid's chunks, which makes them
+// the in-memory checkpoint for search and seeking. save() and restore() turn the
+// full state into bytes and back for checkpoints that outlive the process:
+// "T3DS", a format version, then varints for the simulation and the random
+// state, the grid (see Grid::save) and both pieces. Restoring reads in place,
+// so load() works straight on the mapped file.
+class Simulation {
+
+private:
+	Grid m_grid;
+	Random m_random;
+	StepTimer m_spawnTimer;
+	Block m_currentBlock;
+	Block m_next;
+	bool m_falling;
+	float m_speed;
+	bool m_gameOver;
+	int m_highScore;
+	unsigned m_spawnCount;
+
+	unsigned nextIndex();
+
+public:
+	static const Color FLOOR_COLOR;
+	static const uint32_t STATE_VERSION = 1;
+
+	Simulation(int size, int height, uint64_t seed);
+
+	Simulation(const Simulation& simulation);
+	Simulation& operator=(const Simulation& simulation);
+	void reclaim(Simulation& stale);
+
+	void update(unsigned commands);
+	void restart();
+
+	void save(std::vector<unsigned char>& data) const;
+	bool restore(const unsigned char* data, size_t size);
+	bool save(const char* path) const;
+	bool load(const char* path);
+
+	const Grid& getGrid() const;
+	const Block* getCurrentBlock() const;
+	const Block& getNext() const;
+	bool isGameOver() const;
+	int getHighScore() const;
+	int getLevel() const;
+	unsigned getSpawnCount() const;
+
+};
@@ -0,0 +1,173 @@
+#include "simulationthread.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+SimulationThread::SimulationThread(Replay& replay, bool playback, Bot& bot, bool paused) : m_replay(replay), m_playback(playback), m_bot(bot),
+	m_live(replay.getSize(), replay.getHeight(), replay.getSeed()), m_player(replay),
+	m_snapshots({ playback ? m_player.getSimulation() : m_live, { 0, 0, 0 }, false, paused, false, false, 0, 0, Clock::now() }),
+	m_appliedCount(0), m_shownCount(0), m_seek(0), m_paused(paused), m_autoplay(false), m_fastForward(false), m_running(true), m_tick(0) {
+
+	m_thread = std::thread(&SimulationThread::run, this);
+}
+
+SimulationThread::~SimulationThread() {
+	stop();
+}
+
+const Simulation& SimulationThread::current() const {
+	return m_playback ? m_player.getSimulation() : m_live;
+}
+
+void SimulationThread::run() {
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / StepTimer::TICKS_PER_SECOND;
+	Clock::time_point next = Clock::now();
+	Profiler::setThreadName("simulation");
+
+	while (m_running.load(std::memory_order_relaxed)) {
+		if (m_fastForward.load(std::memory_order_relaxed)) {
+			m_player.fastForward(StepTimer::TICKS_PER_SECOND * 10);
+			m_fastForward = m_playback && !m_player.isFinished();
+			publish({ 0, 0, 0 }, ~0u, 0);
+			next = Clock::now();
+			continue;
+		}
+
+		step();
+
+		// After a stall (a breakpoint, a slow search) resume from now instead of catching up.
+		next += period;
+		const Clock::time_point now = Clock::now();
+		if (now - next > period * 4)
+			next = now;
+
+		std::this_thread::sleep_until(next);
+	}
+}
+
+void SimulationThread::step() {
+	PROFILE_SCOPE("tick");
+	const Simulation& before = current();
+	const Block* block = before.getCurrentBlock();
+	const Point from = block ? block->getPosition() : Point{ 0, 0, 0 };
+	unsigned spawnCount = before.getSpawnCount();
+	const unsigned char orientation = block ? block->getOrientation() : 0;
+
+	// Block::update applies commands in bit order, so a press joins this tick only
+	// if it comes after every command taken so far. The rest wait for later ticks:
+	// two taps of a key between ticks move twice, and a move before a drop is not
+	// turned into a move after it.
+	InputEvent events[8];
+	int eventCount = 0;
+	unsigned commands = 0;
+	while (eventCount < 8 && m_input.peek(events[eventCount]) && events[eventCount].command > commands) {
+		commands |= events[eventCount++].command;
+		m_input.pop();
+	}
+
+	const bool paused = m_paused.load(std::memory_order_relaxed);
+
+	if (m_playback) {
+		const int seek = m_seek.exchange(0, std::memory_order_relaxed);
+		if (seek) {
+			m_player.seek(unsigned(std::max(0ll, (long long)m_player.getTick() + seek)));
+			spawnCount = ~0u;
+		}
+		else if (!paused) {
+			m_player.step();
+		}
+	}
+	else {
+		const bool autoplay = m_autoplay.load(std::memory_order_relaxed);
+		unsigned pressed = 0;
+		if (!paused && !autoplay)
+			pressed = commands & ~COMMAND_RESTART;
+
+		if (m_live.isGameOver())
+			pressed |= commands & COMMAND_RESTART;
+
+		const unsigned input = !paused && autoplay ? m_bot.update(m_live) | pressed : pressed;
+		if (!paused || input) {
+			m_replay.record(input);
+			m_live.update(input);
+		}
+
+		for (int i = 0; i < eventCount; i++)
+			if ((events[i].command & pressed) && m_applied.push(events[i]))
+				m_appliedCount++;
+	}
+
+	m_tick++;
+	publish(from, spawnCount, orientation);
+}
+
+// from, spawnCount and orientation describe the piece before the tick; it is
+// interpolated from there only if it is still the same piece, turned the same way.
+void SimulationThread::publish(const Point& from, unsigned spawnCount, unsigned char orientation) {
+	const Simulation& simulation = current();
+	const Block* block = simulation.getCurrentBlock();
+
+	// The slot being overwritten hands its chunks back, so the live grid copies on write without the heap.
+	Snapshot& snapshot = m_snapshots.back();
+	if (!m_playback)
+		m_live.reclaim(snapshot.simulation);
+	snapshot.simulation = simulation;
+	snapshot.from = from;
+	snapshot.interpolate = block && simulation.getSpawnCount() == spawnCount && block->getOrientation() == orientation;
+	snapshot.paused = m_paused.load(std::memory_order_relaxed);
+	snapshot.autoplay = m_autoplay.load(std::memory_order_relaxed);
+	snapshot.finished = m_playback && m_player.isFinished();
+	snapshot.tick = m_tick;
+	snapshot.applied = m_appliedCount;
+	snapshot.time = Clock::now();
+
+	m_snapshots.publish();
+}
+
+// From one thread only, the one whose window receives the keys.
+void SimulationThread::post(const InputEvent& event) {
+	m_input.push(event);
+}
+
+void SimulationThread::togglePause() {
+	m_paused = !m_paused;
+}
+
+void SimulationThread::toggleAutoplay() {
+	m_autoplay = !m_autoplay;
+}
+
+void SimulationThread::seek(int ticks) {
+	m_seek.fetch_add(ticks, std::memory_order_relaxed);
+}
+
+void SimulationThread::fastForward() {
+	m_fastForward = m_playback;
+}
+
+// Joins the thread; after this the replay may be read or saved.
+void SimulationThread::stop() {
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool SimulationThread::update() {
+	return m_snapshots.update();
+}
+
+const SimulationThread::Snapshot& SimulationThread::getSnapshot() const {
+	return m_snapshots.front();
+}
+
+// The presses applied by the ticks up to the current snapshot, oldest first,
+// each returned once. For the render thread, like update().
+bool SimulationThread::takeShown(InputEvent& event) {
+	if (m_shownCount == getSnapshot().applied || !m_applied.peek(event))
+		return false;
+
+	m_applied.pop();
+	m_shownCount++;
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "simulation.h"
+#include "replay.h"
+#include "replayplayer.h"
+#include "triplebuffer.h"
+#include "bot.h"
+#include "inputqueue.h"
+
+// Runs the game at StepTimer::TICKS_PER_SECOND on its own thread, independent
+// of the frame rate. Key presses arrive in order through an InputQueue and
+// toggles through atomics; after every tick the state is published as a Snapshot, a copy of the
+// simulation that shares the grid's chunks, for the render thread to draw.
+// The session is recorded into replay, or replay is played back.
+class SimulationThread {
+
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Snapshot {
+		Simulation simulation;
+		Point from;
+		bool interpolate;
+		bool paused;
+		bool autoplay;
+		bool finished;
+		unsigned tick;
+		unsigned applied;
+		Clock::time_point time;
+	};
+
+private:
+	Replay& m_replay;
+	const bool m_playback;
+	Bot& m_bot;
+	Simulation m_live;
+	ReplayPlayer m_player;
+	TripleBuffer<Snapshot> m_snapshots;
+	InputQueue m_input;
+	InputQueue m_applied;
+	unsigned m_appliedCount;
+	unsigned m_shownCount;
+	std::atomic<int> m_seek;
+	std::atomic<bool> m_paused;
+	std::atomic<bool> m_autoplay;
+	std::atomic<bool> m_fastForward;
+	std::atomic<bool> m_running;
+	unsigned m_tick;
+	std::thread m_thread;
+
+	const Simulation& current() const;
+	void run();
+	void step();
+	void publish(const Point& from, unsigned spawnCount, unsigned char orientation);
+
+public:
+	SimulationThread(Replay& replay, bool playback, Bot& bot, bool paused);
+	~SimulationThread();
+
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator=(const SimulationThread&) = delete;
+
+	void post(const InputEvent& event);
+	void togglePause();
+	void toggleAutoplay();
+	void seek(int ticks);
+	void fastForward();
+	void stop();
+
+	bool update();
+	const Snapshot& getSnapshot() const;
+	bool takeShown(InputEvent& event);
+
+};
@@ -0,0 +1,93 @@
+#include "sky.h"
+
+static const char* const VERTEX_SOURCE =
+	"#version 330 core\n"
+	"layout(std140) uniform Frame {\n"
+	"	mat4 projection; mat4 view; mat4 lightProjection; mat4 lightView;\n"
+	"	vec4 lightPosition; vec4 lightColor; float shadowMapSize;\n"
+	"};\n"
+	"out vec3 direction;\n"
+	"void main() {\n"
+	"	vec2 position = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;\n"
+	"	direction = transpose(mat3(view)) * vec3(position.x / projection[0][0], position.y / projection[1][1], -1.0);\n"
+	"	gl_Position = vec4(position, 1.0, 1.0);\n"
+	"}\n";
+
+static const char* const FRAGMENT_SOURCE =
+	"#version 330 core\n"
+	"uniform samplerCube sky;\n"
+	"in vec3 direction;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"	color = texture(sky, direction);\n"
+	"}\n";
+
+Sky::Sky(ProgramCache& programs, AssetLoader& loader, const char* const paths[6]) : m_loader(loader), m_texture(0), m_program(programs.build(VERTEX_SOURCE, FRAGMENT_SOURCE)), 
+	m_uniforms(m_program), m_vao(0), m_ready(false) {
+
+	for (int i = 0; i < 6; i++)
+		m_faces[i] = m_loader.request(paths[i]);
+
+	glGenVertexArrays(1, &m_vao);
+	glGenTextures(1, &m_texture);
+}
+
+Sky::~Sky() {
+	glDeleteTextures(1, &m_texture);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteProgram(m_program);
+}
+
+// Uploads the cubemap once every face arrived. A face that failed to load
+// leaves the sky undrawn for good rather than drawn with a hole.
+bool Sky::upload() {
+	for (int face : m_faces)
+		if (m_loader.getState(face) != AssetLoader::READY)
+			return false;
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture);
+	for (int i = 0; i < 6; i++) {
+		const AssetLoader::Image& image = m_loader.getImage(m_faces[i]);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+	}
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	for (int face : m_faces)
+		m_loader.release(face);
+
+	return true;
+}
+
+// Drawn at the far plane after the scene, so only uncovered pixels pay for it.
+// The matrices come from the Frame block; they are uploaded only to a program without it.
+void Sky::render(const engine::Matrix4f& projection, const engine::Matrix4f& view) {
+	if (!m_ready && !(m_ready = upload()))
+		return;
+
+	GLint depthFunction = GL_LESS;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunction);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+
+	glUseProgram(m_program);
+	if (!m_uniforms.hasFrameBlock()) {
+		glUniformMatrix4fv(m_uniforms[UNIFORM_PROJECTION], 1, GL_FALSE, reinterpret_cast<const GLfloat*>(&projection));
+		glUniformMatrix4fv(m_uniforms[UNIFORM_VIEW], 1, GL_FALSE, reinterpret_cast<const GLfloat*>(&view));
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture);
+	glBindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glUseProgram(0);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(depthFunction);
+}
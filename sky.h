@@ -0,0 +1,38 @@
+#pragma once
+
+#include "maths/maths.h"
+#include "graphics/render.h"
+
+#include "assetloader.h"
+#include "uniforms.h"
+#include "programcache.h"
+
+// The skybox as a cubemap looked up along the view ray of every pixel, in one
+// full-screen draw behind everything else. Its faces are requested from the
+// loader, so faces sharing a file are decoded once; the cubemap is uploaded
+// when all have arrived and until then render() draws nothing. Its shader reads
+// the camera from the Frame block of FrameUniforms.
+// Faces are in GL order: +X, -X, +Y, -Y, +Z, -Z.
+class Sky {
+
+private:
+	AssetLoader& m_loader;
+	int m_faces[6];
+	GLuint m_texture;
+	GLuint m_program;
+	Uniforms m_uniforms;
+	GLuint m_vao;
+	bool m_ready;
+
+	bool upload();
+
+public:
+	Sky(ProgramCache& programs, AssetLoader& loader, const char* const paths[6]);
+	~Sky();
+
+	Sky(const Sky&) = delete;
+	Sky& operator=(const Sky&) = delete;
+
+	void render(const engine::Matrix4f& projection, const engine::Matrix4f& view);
+
+};
@@ -0,0 +1,24 @@
+#include "steptimer.h"
+
+StepTimer::StepTimer(unsigned delay, unsigned now) : m_delay(delay), m_last(now) {
+}
+
+bool StepTimer::ready(unsigned now) {
+	if (now - m_last < m_delay)
+		return false;
+
+	m_last = now;
+	return true;
+}
+
+void StepTimer::reset(unsigned now) {
+	m_last = now;
+}
+
+unsigned StepTimer::getDelay() const {
+	return m_delay;
+}
+
+unsigned StepTimer::getLast() const {
+	return m_last;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+class StepTimer {
+
+private:
+	unsigned m_delay;
+	unsigned m_last;
+
+public:
+	static const unsigned TICKS_PER_SECOND = 60;
+
+	static constexpr unsigned milliseconds(unsigned ms) {
+		return (ms * TICKS_PER_SECOND + 999) / 1000;
+	}
+
+	StepTimer(unsigned delay, unsigned now = 0);
+
+	bool ready(unsigned now);
+	void reset(unsigned now);
+
+	unsigned getDelay() const;
+	unsigned getLast() const;
+
+};
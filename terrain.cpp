@@ -1,182 +1,147 @@
-#include "terrain.h"
-
-Terrain::Terrain(engine::Vector3f size) : m_shader("resources/terrain.vs", "resources/terrain.fs"), m_size(size), m_blockModel(engine::Shape3D::cube(0.5f).createModel()), 
-	m_removeTimer(300), m_removeColor(new engine::Vector4f(0.2f, 0.2f, 0.2f, 1.0f)), m_instancedRender(m_blockModel.getVAO()) {
-
-	for (int i = 0; i < m_size.x * m_size.y * m_size.z; i++)
-		m_blocks.push_back(nullptr);
-
-	m_instancedRender.addInstancedAttribute(3, 3, m_blocks.size());
-	m_instancedRender.addInstancedAttribute(4, 4, m_blocks.size());
-}
-
-void Terrain::updateInstances(GLfloat*& vectors, GLfloat*& colors) {
-	std::vector<GLfloat> rawVectors;
-	std::vector<GLfloat> rawColors;
-
-	rawVectors.reserve(m_blockCount * 3);
-	rawColors.reserve(m_blockCount * 4);
-
-	m_blockCount = 0;
-
-	for (int i = 0; i < m_size.x; i++) {
-		for (int j = 0; j < m_size.y; j++) {
-			for (int k = 0; k < m_size.z; k++) {
-				if (!m_blocks[(k * m_size.y + j) * m_size.x + i])
-					continue;
-
-				rawVectors.push_back(i - m_size.x / 2.0f);
-				rawVectors.push_back(j - m_size.y / 2.0f);
-				rawVectors.push_back(k - m_size.z / 2.0f);
-
-				rawColors.push_back(m_blocks[(k * m_size.y + j) * m_size.x + i]->x);
-				rawColors.push_back(m_blocks[(k * m_size.y + j) * m_size.x + i]->y);
-				rawColors.push_back(m_blocks[(k * m_size.y + j) * m_size.x + i]->z);
-				rawColors.push_back(m_blocks[(k * m_size.y + j) * m_size.x + i]->w);
-
-				m_blockCount++;
-			}
-		}
-	}
-
-	vectors = new GLfloat[m_blockCount * 3];
-	for (int i = 0; i < rawVectors.size(); i++)
-		vectors[i] = rawVectors[i];
-
-	colors = new GLfloat[m_blockCount * 4];
-	for (int i = 0; i < rawColors.size(); i++)
-		colors[i] = rawColors[i];
-}
-
-void Terrain::update() {
-	if (m_removeRow)
-		if (m_removeTimer.ready())
-			remove();
-}
-
-void Terrain::render(engine::Shader* shader, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light, bool shadow) {
-	if (!shader)
-		shader = &m_shader;
-
-	shader->enable();
-	shader->setUniformMatrix4f(shader->getUniformLocation("projection"), projection);
-	shader->setUniformMatrix4f(shader->getUniformLocation("view"), view);
-	if (!shadow) {
-		shader->setUniform3f(shader->getUniformLocation("lightPosition"), light.getPosition());
-		shader->setUniform4f(shader->getUniformLocation("lightColor"), light.getColor());
-	}
-
-	//updateInstances(m_vectors, m_colors);
-
-	//m_instancedRender.updateAttribute(0, 3, m_blockCount, m_vectors);
-	//m_instancedRender.updateAttribute(1, 4, m_blockCount, m_colors);
-
-	//engine::Render::renderBatch(m_instancedRender, m_blockModel, m_blockCount);
-
-	m_blockModel.bind();
-
-	for (int i = 0; i < m_size.x; i++) {
-		for (int j = 0; j < m_size.y; j++) {
-			for (int k = 0; k < m_size.z; k++) {
-				if (!m_blocks[(k * m_size.y + j) * m_size.x + i])
-					continue;
-				shader->setUniform3f(shader->getUniformLocation("blockPosition"), (i - m_size.x / 2.0f), (j - m_size.y / 2.0f), (k - m_size.z / 2.0f));
-				if (!shadow)
-					shader->setUniform4f(shader->getUniformLocation("blockColor"), *m_blocks[(k * m_size.y + j) * m_size.x + i]);
-				engine::Render::renderNoBind(m_blockModel.getIndexLength());
-			}
-		}
-	}
-
-	m_blockModel.unbind();
-
-	shader->disable();
-}
-
-void Terrain::set(int x, int y, int z, engine::Vector4f* color) {
-	m_blocks[(z * m_size.y + y) * m_size.x + x] = color;
-}
-
-void Terrain::remove() {
-	int count = 0;
-	for (int i = 1; i < m_size.x - 1; i++)
-		for (int j = 1; j < m_size.y - 1; j++)
-			for (int k = 1; k < m_size.z - 1; k++)
-				if (m_blocks[(k * m_size.y + j) * m_size.x + i] == m_removeColor)
-					count += removeRow(i, j, k);
-
-	addScore(count * count);
-}
-
-int Terrain::removeRow(int x, int y, int z) {
-	int count = 1;
-	for (int l = y; l < m_size.y - 1; l++)
-		m_blocks[(z * m_size.y + l) * m_size.x + x] = m_blocks[(z * m_size.y + l + 1) * m_size.x + x];
-
-		if (m_blocks[(z * m_size.y + y) * m_size.x + x] == m_removeColor)
-		count += removeRow(x, y, z);
-
-	return count;
-}
-
-bool Terrain::check(int x, int y, int z) {
-	bool ready = false;
-	bool valid = true;
-	for (int i = 1; i < m_size.z - 1; i++)
-		if (!m_blocks[(i * m_size.y + y) * m_size.x + x])
-			valid = false;
-
-	if (valid) {
-		m_removeRow = true;
-		m_removeTimer.reset();
-		for (int i = 1; i < m_size.z - 1; i++)
-			m_blocks[(i * m_size.y + y) * m_size.x + x] = m_removeColor;
-	}
-
-	if (valid)
-		ready = true;
-
-	valid = true;
-	for (int i = 1; i < m_size.x - 1; i++)
-		if (!m_blocks[(z * m_size.y + y) * m_size.x + i])
-			valid = false;
-
-	if (valid) {
-		m_removeRow = true;
-		m_removeTimer.reset();
-		for (int i = 1; i < m_size.x - 1; i++)
-			m_blocks[(z * m_size.y + y) * m_size.x + i] = m_removeColor;
-	}
-
-	return valid ? true : ready;
-}
-
-bool Terrain::isReady() const {
-	for (int i = 1; i < m_size.x - 1; i++)
-		for (int j = 1; j < m_size.y - 1; j++)
-			for (int k = 1; k < m_size.z - 1; k++)
-				if (m_blocks[(k * m_size.y + j) * m_size.x + i] == m_removeColor)
-					return false;
-
-	return true;
-}
-
-const std::vector<engine::Vector4f*>& Terrain::getBlocks() const {
-	return m_blocks;
-}
-
-engine::Shader& Terrain::getShader() {
-	return m_shader;
-}
-
-const engine::Vector3f& Terrain::getSize() const {
-	return m_size;
-}
-
-void Terrain::addScore(int score) {
-	m_score += score;
-}
-
-int Terrain::getScore() const {
-	return m_score;
-}
+#include "terrain.h"
+
+#include <cstring>
+
+#include "profiler.h"
+
+Terrain::Terrain(ProgramCache& programs, const Grid& grid) : m_grid(grid), m_program(programs, "resources/terrain.vs", "resources/terrain.fs"), m_vao(0), m_vertexBuffer(0), 
+	m_vertexCapacity(0), m_vertexCount(0) {
+
+	const GLsizei stride = Mesher::VERTEX_FLOATS * sizeof(GLfloat);
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vertexBuffer);
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void*) 0);
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (const void*) (3 * sizeof(GLfloat)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Terrain::~Terrain() {
+	glDeleteBuffers(1, &m_vertexBuffer);
+	glDeleteVertexArrays(1, &m_vao);
+}
+
+void Terrain::updateMesh() {
+	PROFILE_SCOPE("Terrain::updateMesh");
+	if (!m_mesher.update(m_grid))
+		return;
+
+	m_vertexCount = m_mesher.getVertexCount();
+
+	// The whole store is uploaded, spare room included: the batches index into it.
+	const std::vector<float>& vertices = m_mesher.getVertices();
+	const int stored = int(vertices.size() / Mesher::VERTEX_FLOATS);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+
+	if (stored > m_vertexCapacity)
+		m_vertexCapacity = stored + stored / 2;
+
+	// Orphan the previous storage so the driver never waits on draws still reading it.
+	glBufferData(GL_ARRAY_BUFFER, m_vertexCapacity * Mesher::VERTEX_FLOATS * sizeof(GLfloat), nullptr, GL_STREAM_DRAW);
+
+	if (stored > 0) {
+		const GLsizeiptr bytes = vertices.size() * sizeof(GLfloat);
+		bool written = false;
+		if (void* data = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT)) {
+			std::memcpy(data, vertices.data(), bytes);
+			written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+		}
+
+		// A map that failed, or storage lost while mapped, is filled by a plain copy instead.
+		if (!written)
+			glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices.data());
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// The shadow pass is given the light matrices as projection and view, which
+// the Frame block holds under other names, so they are uploaded even with it.
+void Terrain::enable(const Program& program, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light, bool shadow) {
+	const Uniforms& uniforms = program.getUniforms();
+	program.enable();
+	if (shadow || !uniforms.hasFrameBlock()) {
+		program.setUniformMatrix4f(uniforms[UNIFORM_PROJECTION], projection);
+		program.setUniformMatrix4f(uniforms[UNIFORM_VIEW], view);
+	}
+	if (!shadow && !uniforms.hasFrameBlock()) {
+		program.setUniform3f(uniforms[UNIFORM_LIGHT_POSITION], light.getPosition());
+		program.setUniform4f(uniforms[UNIFORM_LIGHT_COLOR], light.getColor());
+	}
+}
+
+void Terrain::render(const Program* program, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light, bool shadow) {
+	if (!program)
+		program = &m_program;
+
+	const Uniforms& uniforms = program->getUniforms();
+	enable(*program, projection, view, light, shadow);
+
+	updateMesh();
+
+	// The mesh carries absolute positions, so the block offset stays at zero.
+	program->setUniform3f(uniforms[UNIFORM_BLOCK_POSITION], 0.0f, 0.0f, 0.0f);
+
+	glBindVertexArray(m_vao);
+	for (const Mesher::Batch& batch : m_mesher.getBatches()) {
+		if (batch.firsts.empty())
+			continue;
+
+		if (!shadow)
+			program->setUniform4f(uniforms[UNIFORM_BLOCK_COLOR], engine::Vector4f(batch.color->r, batch.color->g, batch.color->b, batch.color->a));
+		glMultiDrawArrays(GL_TRIANGLES, batch.firsts.data(), batch.counts.data(), GLsizei(batch.firsts.size()));
+	}
+	glBindVertexArray(0);
+
+	program->disable();
+}
+
+// The piece is drawn cube by cube through the blockPosition and blockColor
+// uniforms, as the block shaders have always read them.
+void Terrain::renderPiece(const Program* program, const engine::Model& blockModel, const PieceView& piece, const engine::Matrix4f& projection, const engine::Matrix4f& view, 
+	const engine::Light& light, bool shadow) {
+
+	if (!program)
+		program = &m_program;
+
+	const Uniforms& uniforms = program->getUniforms();
+	enable(*program, projection, view, light, shadow);
+	const Point& size = m_grid.getSize();
+	const Color& color = Block::COLORS[piece.index];
+
+	blockModel.bind();
+	program->setUniform4f(uniforms[UNIFORM_BLOCK_COLOR], engine::Vector4f(color.r, color.g, color.b, color.a));
+
+	for (const Point& v : piece.cells) {
+		const float x = v.x + piece.offset[0] - size.x / 2.0f;
+		const float y = v.y + piece.offset[1] - size.y / 2.0f;
+		const float z = v.z + piece.offset[2] - size.z / 2.0f;
+		program->setUniform3f(uniforms[UNIFORM_BLOCK_POSITION], x, y, z);
+		engine::Render::renderNoBind(blockModel.getIndexLength());
+	}
+
+	blockModel.unbind();
+	program->disable();
+}
+
+const Program& Terrain::getProgram() const {
+	return m_program;
+}
+
+engine::Vector3f Terrain::getSize() const {
+	return engine::Vector3f(m_grid.getSize().x, m_grid.getSize().y, m_grid.getSize().z);
+}
+
+int Terrain::getVertexCount() const {
+	return m_vertexCount;
+}
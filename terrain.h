@@ -1,49 +1,54 @@
-#pragma once
-
-#include <vector>
-
-#include "maths/maths.h"
-#include "graphics/shader.h"
-#include "graphics/render.h"
-#include "graphics/instancedRender.h"
-#include "entities/light.h"
-#include "models/model.h"
-#include "utilities/primitives.h"
-#include "utilities/timer.h"
-
-class Terrain {
-
-private:
-	std::vector<engine::Vector4f*> m_blocks;
-	GLfloat* m_vectors, *m_colors;
-	engine::InstancedRender m_instancedRender;
-	const engine::Model m_blockModel;
-	const engine::Vector3f m_size;
-	engine::Vector4f* m_removeColor;
-	engine::Shader m_shader;
-	engine::Timer m_removeTimer;
-	bool m_removeRow;
-	int m_blockCount;
-	int m_score;
-
-	void remove();
-	int removeRow(int x, int y, int z);
-	void updateInstances(GLfloat*& vectors, GLfloat*& colors);
-
-public:
-	Terrain(engine::Vector3f size);
-
-	void update();
-	void render(engine::Shader* shader, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light, bool shadow = false);
-
-	void set(int x, int y, int z, engine::Vector4f* color);
-	bool check(int x, int y, int z);
-
-	bool isReady() const;
-	const std::vector<engine::Vector4f*>& getBlocks() const;
-	engine::Shader& getShader();
-	const engine::Vector3f& getSize() const;
-	void addScore(int score);
-	int getScore() const;
-
-};
+#pragma once
+
+#include "maths/maths.h"
+#include "graphics/render.h"
+#include "entities/light.h"
+
+#include "grid.h"
+#include "block.h"
+#include "mesher.h"
+#include "program.h"
+#include "programcache.h"
+
+// A piece drawn apart from the board mesh: its cells moved by a fractional offset.
+struct PieceView {
+	BlockCells cells;
+	float offset[3];
+	unsigned index;
+};
+
+// Draws the greedy mesh of the grid with one call per color, through the same
+// blockPosition and blockColor uniforms as a single cube: vertices carry
+// absolute positions (attribute 0) and normals (2), blockPosition stays zero
+// and blockColor is set per batch. The vertex buffer is orphaned and refilled
+// only when the mesher rebuilt a layer.
+class Terrain {
+
+private:
+	const Grid& m_grid;
+	Mesher m_mesher;
+	Program m_program;
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	int m_vertexCapacity;
+	int m_vertexCount;
+
+	void updateMesh();
+	void enable(const Program& program, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light, bool shadow);
+
+public:
+	Terrain(ProgramCache& programs, const Grid& grid);
+	~Terrain();
+
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	void render(const Program* program, const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Light& light, bool shadow = false);
+	void renderPiece(const Program* program, const engine::Model& blockModel, const PieceView& piece, const engine::Matrix4f& projection, const engine::Matrix4f& view, 
+		const engine::Light& light, bool shadow = false);
+
+	const Program& getProgram() const;
+	engine::Vector3f getSize() const;
+	int getVertexCount() const;
+
+};
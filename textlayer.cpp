@@ -0,0 +1,116 @@
+#include "textlayer.h"
+
+static const char* const VERTEX_SOURCE =
+	"#version 330 core\n"
+	"out vec2 uv;\n"
+	"void main() {\n"
+	"	uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+	"	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+static const char* const FRAGMENT_SOURCE =
+	"#version 330 core\n"
+	"uniform sampler2D text;\n"
+	"in vec2 uv;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"	color = texture(text, uv);\n"
+	"}\n";
+
+TextLayer::TextLayer(ProgramCache& programs, engine::Font& font, GLint location) : m_font(font), m_location(location), m_framebuffer(0), m_texture(0), m_program(0), m_vao(0),
+	m_width(0), m_height(0), m_dirty(true) {
+
+	m_program = programs.build(VERTEX_SOURCE, FRAGMENT_SOURCE);
+
+	glGenVertexArrays(1, &m_vao);
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenTextures(1, &m_texture);
+}
+
+TextLayer::~TextLayer() {
+	glDeleteTextures(1, &m_texture);
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteProgram(m_program);
+}
+
+void TextLayer::clear() {
+	m_labels.clear();
+	m_dirty = true;
+}
+
+void TextLayer::add(const std::string& text, float x, float y, float size) {
+	m_labels.push_back({ text, x, y, size });
+	m_dirty = true;
+}
+
+void TextLayer::resize(int width, int height) {
+	m_width = width;
+	m_height = height;
+
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_dirty = true;
+}
+
+void TextLayer::redraw() {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Keep the texture premultiplied so compositing it matches drawing the text directly.
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	m_font.enableShader();
+	for (const Label& label : m_labels) {
+		m_font.getShader().setUniform2f(m_location, engine::Vector2f(label.x, label.y));
+		m_font.render(label.text, label.size);
+	}
+	m_font.disableShader();
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_dirty = false;
+}
+
+// Composites into whichever framebuffer is bound, the offscreen capture target included.
+void TextLayer::render(int width, int height) {
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+	if (width != m_width || height != m_height)
+		resize(width, height);
+
+	if (m_dirty)
+		redraw();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+	glViewport(0, 0, width, height);
+
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	glUseProgram(m_program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glBindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+}
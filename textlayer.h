@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "graphics/gui/font.h"
+
+#include "programcache.h"
+
+// Screen text that is drawn with the engine font into a texture only after the
+// labels were replaced, and otherwise composited over the frame with a single
+// draw. Labels use the font's own placement: location is in the unit square.
+class TextLayer {
+
+private:
+	struct Label {
+		std::string text;
+		float x;
+		float y;
+		float size;
+	};
+
+	engine::Font& m_font;
+	const GLint m_location;
+	std::vector<Label> m_labels;
+	GLuint m_framebuffer;
+	GLuint m_texture;
+	GLuint m_program;
+	GLuint m_vao;
+	int m_width;
+	int m_height;
+	bool m_dirty;
+
+	void resize(int width, int height);
+	void redraw();
+
+public:
+	TextLayer(ProgramCache& programs, engine::Font& font, GLint location);
+	~TextLayer();
+
+	TextLayer(const TextLayer&) = delete;
+	TextLayer& operator=(const TextLayer&) = delete;
+
+	void clear();
+	void add(const std::string& text, float x, float y, float size);
+
+	void render(int width, int height);
+
+};
@@ -0,0 +1,109 @@
+#include "threadpool.h"
+
+#include "profiler.h"
+
+ThreadPool::ThreadPool(unsigned threads) : m_pending(0), m_queued(0), m_next(0), m_running(true) {
+	for (unsigned i = 0; i < threads + 1; i++)
+		m_queues.emplace_back(new Queue);
+
+	for (unsigned i = 0; i < threads; i++)
+		m_threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+
+	m_condition.notify_all();
+
+	for (std::thread& thread : m_threads)
+		thread.join();
+}
+
+bool ThreadPool::pop(int index, std::function<void(int)>& task) {
+	{
+		Queue& own = *m_queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.front());
+			own.tasks.pop_front();
+			m_queued--;
+			return true;
+		}
+	}
+
+	for (unsigned i = 1; i < m_queues.size(); i++) {
+		Queue& victim = *m_queues[(index + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			m_queued--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::work(int index) {
+	Profiler::setThreadName("worker");
+	std::function<void(int)> task;
+
+	while (true) {
+		if (pop(index, task)) {
+			task(index);
+			task = nullptr;
+
+			if (--m_pending == 0) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_condition.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this] { return !m_running || m_queued > 0; });
+		if (!m_running)
+			return;
+	}
+}
+
+void ThreadPool::submit(std::function<void(int)> task) {
+	Queue& queue = *m_queues[m_next++ % m_queues.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending++;
+		m_queued++;
+	}
+
+	m_condition.notify_one();
+}
+
+void ThreadPool::wait() {
+	const int index = m_threads.size();
+	std::function<void(int)> task;
+
+	while (m_pending > 0) {
+		if (pop(index, task)) {
+			task(index);
+			task = nullptr;
+			--m_pending;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this] { return m_pending == 0 || m_queued > 0; });
+	}
+}
+
+int ThreadPool::getThreadCount() const {
+	return m_threads.size() + 1;
+}
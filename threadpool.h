@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of workers, each with its own task deque. A worker takes tasks from
+// the front of its own deque and, once that is empty, steals from the back of
+// the others. Tasks get the index of the thread running them, in 0 .. getThreadCount()
+// (the last index is the thread calling wait(), which helps until all tasks finished).
+// With zero threads every task runs inline inside wait().
+class ThreadPool {
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void(int)>> tasks;
+	};
+
+	std::vector<std::thread> m_threads;
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::atomic<int> m_pending;
+	std::atomic<int> m_queued;
+	std::atomic<unsigned> m_next;
+	bool m_running;
+
+	bool pop(int index, std::function<void(int)>& task);
+	void work(int index);
+
+public:
+	ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void(int)> task);
+	void wait();
+
+	int getThreadCount() const;
+
+};
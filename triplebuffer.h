@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+
+// Hands values from one writer thread to one reader thread without locks. The
+// writer fills back() and publishes it; the reader picks up the most recently
+// published value with update() and reads front() until its next update().
+// Neither side ever waits, and values published in between are dropped.
+template<typename T>
+class TripleBuffer {
+
+private:
+	static const unsigned FRESH = 4;
+	static const unsigned INDEX = 3;
+
+	T m_slots[3];
+	std::atomic<unsigned> m_middle;
+	unsigned m_back;
+	unsigned m_front;
+
+public:
+	TripleBuffer(const T& value) : m_slots{ value, value, value }, m_middle(1), m_back(0), m_front(2) {
+	}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	T& back() {
+		return m_slots[m_back];
+	}
+
+	void publish() {
+		m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Returns whether a new value was published since the last call.
+	bool update() {
+		if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	const T& front() const {
+		return m_slots[m_front];
+	}
+
+};
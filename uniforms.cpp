@@ -0,0 +1,97 @@
+#include "uniforms.h"
+
+#include <cstring>
+
+static const char* const NAMES[UNIFORM_COUNT] = {
+	"projection",
+	"view",
+	"lightPosition",
+	"lightColor",
+	"lightProjection",
+	"lightView",
+	"shadowMapSize",
+	"transformation",
+	"blockPosition",
+	"blockColor",
+	"location",
+	"textColor"
+};
+
+static const int MATRIX_FLOATS = 16;
+static const int FRAME_FLOATS = 4 * MATRIX_FLOATS + 4 + 4 + 4;
+
+static_assert(sizeof(engine::Matrix4f) == MATRIX_FLOATS * sizeof(float), "Matrix4f is uploaded as 16 floats");
+
+static GLint currentProgram(engine::Shader& shader) {
+	GLint program = 0;
+	shader.enable();
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	shader.disable();
+	return program;
+}
+
+// A program that failed to link has no uniforms to look up; every name resolves to -1.
+Uniforms::Uniforms(GLuint program) : m_frameBlock(false) {
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	for (int i = 0; i < UNIFORM_COUNT; i++)
+		m_locations[i] = linked ? glGetUniformLocation(program, NAMES[i]) : -1;
+	if (!linked)
+		return;
+
+	const GLuint block = glGetUniformBlockIndex(program, "Frame");
+	if (block != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, block, FRAME_BINDING);
+		m_frameBlock = true;
+	}
+}
+
+// An engine shader does not expose its program, so it is read back while bound.
+Uniforms::Uniforms(engine::Shader& shader) : Uniforms(GLuint(currentProgram(shader))) {
+}
+
+GLint Uniforms::operator[](Uniform uniform) const {
+	return m_locations[uniform];
+}
+
+bool Uniforms::hasFrameBlock() const {
+	return m_frameBlock;
+}
+
+FrameUniforms::FrameUniforms() : m_buffer(0) {
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, FRAME_FLOATS * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, Uniforms::FRAME_BINDING, m_buffer);
+}
+
+FrameUniforms::~FrameUniforms() {
+	glDeleteBuffers(1, &m_buffer);
+}
+
+void FrameUniforms::update(const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Matrix4f& lightProjection, const engine::Matrix4f& lightView,
+	const engine::Light& light, float shadowMapSize) {
+
+	// std140: four column major matrices, then two vec4 and a float padded to a vec4.
+	float data[FRAME_FLOATS] = {};
+	std::memcpy(data, &projection, sizeof(engine::Matrix4f));
+	std::memcpy(data + MATRIX_FLOATS, &view, sizeof(engine::Matrix4f));
+	std::memcpy(data + 2 * MATRIX_FLOATS, &lightProjection, sizeof(engine::Matrix4f));
+	std::memcpy(data + 3 * MATRIX_FLOATS, &lightView, sizeof(engine::Matrix4f));
+
+	float* tail = data + 4 * MATRIX_FLOATS;
+	tail[0] = light.getPosition().x;
+	tail[1] = light.getPosition().y;
+	tail[2] = light.getPosition().z;
+	tail[3] = 1.0f;
+	tail[4] = light.getColor().x;
+	tail[5] = light.getColor().y;
+	tail[6] = light.getColor().z;
+	tail[7] = light.getColor().w;
+	tail[8] = shadowMapSize;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
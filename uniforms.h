@@ -0,0 +1,69 @@
+#pragma once
+
+#include "maths/maths.h"
+#include "graphics/shader.h"
+#include "entities/light.h"
+
+enum Uniform {
+	UNIFORM_PROJECTION,
+	UNIFORM_VIEW,
+	UNIFORM_LIGHT_POSITION,
+	UNIFORM_LIGHT_COLOR,
+	UNIFORM_LIGHT_PROJECTION,
+	UNIFORM_LIGHT_VIEW,
+	UNIFORM_SHADOW_MAP_SIZE,
+	UNIFORM_TRANSFORMATION,
+	UNIFORM_BLOCK_POSITION,
+	UNIFORM_BLOCK_COLOR,
+	UNIFORM_LOCATION,
+	UNIFORM_TEXT_COLOR,
+	UNIFORM_COUNT
+};
+
+// The uniform locations of a program, looked up once when it is wrapped. Names
+// the program does not use resolve to -1, which GL ignores on upload.
+// A shader that declares the Frame block below reads the per-frame matrices and
+// light from FrameUniforms instead, and hasFrameBlock() tells callers to skip
+// uploading them:
+//	layout(std140) uniform Frame {
+//		mat4 projection; mat4 view; mat4 lightProjection; mat4 lightView;
+//		vec4 lightPosition; vec4 lightColor; float shadowMapSize;
+//	};
+// Block members are not plain uniforms, so projection and view resolve to -1 in
+// such a shader; a shadow shader with the block reads lightProjection and
+// lightView instead.
+class Uniforms {
+
+private:
+	GLint m_locations[UNIFORM_COUNT];
+	bool m_frameBlock;
+
+public:
+	static const GLuint FRAME_BINDING = 0;
+
+	Uniforms(GLuint program);
+	Uniforms(engine::Shader& shader);
+
+	GLint operator[](Uniform uniform) const;
+
+	bool hasFrameBlock() const;
+
+};
+
+// The Frame block contents, written once per frame into one uniform buffer.
+class FrameUniforms {
+
+private:
+	GLuint m_buffer;
+
+public:
+	FrameUniforms();
+	~FrameUniforms();
+
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	void update(const engine::Matrix4f& projection, const engine::Matrix4f& view, const engine::Matrix4f& lightProjection, const engine::Matrix4f& lightView,
+		const engine::Light& light, float shadowMapSize);
+
+};